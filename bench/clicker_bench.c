@@ -0,0 +1,517 @@
+// Throughput and latency harness for a running clicker daemon. Opens N
+// editor connections to nvim_clack and measures, per run:
+//   - connect overhead: CreateFile + hello write, per connection
+//   - typing: every connection replays a trace at the given WPM, with a
+//     paste burst (one write of many events) every so many keys
+//   - flood: every connection writes events back to back; events/s
+// End-to-end latency comes from the daemon's own histograms: the stats
+// pipe is snapshotted around each phase and the bucket deltas give the
+// read -> device-submit percentiles for just that phase's events.
+// Writes one JSON object to stdout.
+//
+// Usage: clicker_bench [--connections N] [--wpm W] [--paste-every K]
+//                      [--paste-size L] [--flood E] [--trace <file>]
+#define WIN32_LEAN_AND_MEAN
+
+// clang-format off
+#include <windows.h>
+// clang-format on
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+static const char *const PIPE_NAME = "\\\\.\\pipe\\nvim_clack";
+static const char *const STATS_PIPE_NAME = "\\\\.\\pipe\\nvim_clack_stats";
+static constexpr int DEFAULT_CONNECTIONS = 4;
+static constexpr int MAX_CONNECTIONS = 64;
+static constexpr int DEFAULT_WPM = 120;
+static constexpr int DEFAULT_PASTE_EVERY = 80;
+static constexpr int DEFAULT_PASTE_SIZE = 200;
+static constexpr int DEFAULT_FLOOD = 20000;
+static constexpr int CHARS_PER_WORD = 5; // The usual WPM convention
+static constexpr size_t MAX_TRACE_BYTES = 64 * 1024;
+static constexpr int FLOOD_FRAME_EVENTS = 64; // Events per flood write
+static constexpr int MAX_PASTE_SIZE = 1024;
+static constexpr DWORD CONNECT_TIMEOUT_MS = 2000;
+static constexpr DWORD DRAIN_MS = 250; // Lets the last buffers reach the device
+static constexpr size_t STATS_BUFFER_SIZE = 4096;
+
+// Protocol v1: magic, version, empty hello body; events are length-prefixed
+static const BYTE HELLO[] = {'N', 'C', 'L', 'K', 1, 0};
+static constexpr int EVENT_FRAME_BYTES = 7; // len, code, timestamp, intensity
+
+// Must match the daemon's log-linear layout (clicker.c)
+static constexpr int LATENCY_LINEAR_BUCKETS = 8;
+static constexpr int LATENCY_SUB_BUCKET_BITS = 2;
+static constexpr int LATENCY_BUCKETS = 64;
+
+static const char DEFAULT_TRACE[] =
+    "static void Render(float *out, uint32_t frames) {\n"
+    "  for (uint32_t i = 0; i < frames; i++) {\n"
+    "    out[i] = voices[i % count].gain * sample[i];\n"
+    "  }\n"
+    "}\n";
+
+typedef struct {
+  uint64_t events;
+  uint64_t voices;
+  uint64_t merges;
+  uint64_t drops;
+  uint64_t submit[LATENCY_BUCKETS];
+  uint64_t decode[LATENCY_BUCKETS];
+} StatsSnapshot;
+
+typedef struct {
+  HANDLE pipe;
+  const char *trace;
+  size_t trace_length;
+  int64_t key_interval_ticks;
+  int paste_every;
+  int paste_size;
+  int flood;
+  uint64_t sent;
+  uint64_t slowest_write_us;
+  bool failed;
+} Connection;
+
+static int64_t qpc_ticks_per_second = 1;
+
+[[nodiscard]]
+static int64_t NowTicks(void) {
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return now.QuadPart;
+}
+
+[[nodiscard]]
+static uint64_t TicksToMicros(int64_t ticks) {
+  return (uint64_t)ticks * 1000000u / (uint64_t)qpc_ticks_per_second;
+}
+
+[[nodiscard]]
+static uint8_t EventCode(char c) {
+  if (c == ' ')
+    return 's';
+  if (c == '\n')
+    return 'e';
+  return 'k';
+}
+
+static void EncodeEvent(BYTE *frame, uint8_t code, uint32_t timestamp_ms) {
+  frame[0] = EVENT_FRAME_BYTES - 1;
+  frame[1] = code;
+  frame[2] = (BYTE)timestamp_ms;
+  frame[3] = (BYTE)(timestamp_ms >> 8);
+  frame[4] = (BYTE)(timestamp_ms >> 16);
+  frame[5] = (BYTE)(timestamp_ms >> 24);
+  frame[6] = 255;
+}
+
+[[nodiscard]]
+static bool WriteAll(Connection *connection, const BYTE *data, DWORD size) {
+  const int64_t start = NowTicks();
+  DWORD written = 0;
+  if (WriteFile(connection->pipe, data, size, &written, nullptr) == FALSE ||
+      written != size) {
+    connection->failed = true;
+    return false;
+  }
+  const uint64_t us = TicksToMicros(NowTicks() - start);
+  if (us > connection->slowest_write_us) {
+    connection->slowest_write_us = us;
+  }
+  return true;
+}
+
+// ============================================================
+// STATS ENDPOINT
+// ============================================================
+[[nodiscard]]
+static bool ParseCounter(const char *json, const char *name, uint64_t *out) {
+  char key[32];
+  snprintf(key, sizeof(key), "\"%s\":", name);
+  const char *at = strstr(json, key);
+  if (at == nullptr)
+    return false;
+  *out = strtoull(at + strlen(key), nullptr, 10);
+  return true;
+}
+
+[[nodiscard]]
+static bool ParseBuckets(const char *json, const char *stage,
+                         uint64_t out[LATENCY_BUCKETS]) {
+  char key[32];
+  snprintf(key, sizeof(key), "\"%s\":{", stage);
+  const char *at = strstr(json, key);
+  if (at == nullptr || (at = strstr(at, "\"buckets\":[")) == nullptr)
+    return false;
+  at += strlen("\"buckets\":[");
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    char *end = nullptr;
+    out[b] = strtoull(at, &end, 10);
+    if (end == at)
+      return false;
+    at = end + 1; // Past the comma (or the closing bracket)
+  }
+  return true;
+}
+
+[[nodiscard]]
+static bool ReadStats(StatsSnapshot *snapshot) {
+  if (WaitNamedPipeA(STATS_PIPE_NAME, CONNECT_TIMEOUT_MS) == FALSE)
+    return false;
+  HANDLE pipe = CreateFileA(STATS_PIPE_NAME, GENERIC_READ, 0, nullptr,
+                            OPEN_EXISTING, 0, nullptr);
+  if (pipe == INVALID_HANDLE_VALUE)
+    return false;
+
+  static char json[STATS_BUFFER_SIZE];
+  DWORD received = 0;
+  const bool read_ok = ReadFile(pipe, json, sizeof(json) - 1, &received,
+                                nullptr) != FALSE;
+  CloseHandle(pipe);
+  if (!read_ok)
+    return false;
+  json[received] = '\0';
+
+  return ParseCounter(json, "events", &snapshot->events) &&
+         ParseCounter(json, "voices", &snapshot->voices) &&
+         ParseCounter(json, "merges", &snapshot->merges) &&
+         ParseCounter(json, "drops", &snapshot->drops) &&
+         ParseBuckets(json, "submit", snapshot->submit) &&
+         ParseBuckets(json, "decode", snapshot->decode);
+}
+
+[[nodiscard]]
+static uint64_t LatencyBucketLimit(int index) {
+  if (index < LATENCY_LINEAR_BUCKETS)
+    return (uint64_t)index;
+
+  const int octave = ((index - LATENCY_LINEAR_BUCKETS) >>
+                      LATENCY_SUB_BUCKET_BITS) + 3;
+  const uint64_t sub =
+      (uint64_t)(index - LATENCY_LINEAR_BUCKETS) &
+      ((1u << LATENCY_SUB_BUCKET_BITS) - 1);
+  const uint64_t base = (uint64_t)1 << LATENCY_SUB_BUCKET_BITS;
+  return ((base + sub + 1) << (octave - LATENCY_SUB_BUCKET_BITS)) - 1;
+}
+
+// Percentile of the events recorded between two snapshots
+[[nodiscard]]
+static uint64_t DeltaPercentile(const uint64_t *before, const uint64_t *after,
+                                double fraction, uint64_t *count) {
+  uint64_t total = 0;
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    total += after[b] - before[b];
+  }
+  *count = total;
+  const uint64_t rank = (uint64_t)ceil((double)total * fraction);
+  uint64_t seen = 0;
+  for (int b = 0; b < LATENCY_BUCKETS && total > 0; b++) {
+    seen += after[b] - before[b];
+    if (seen >= rank)
+      return LatencyBucketLimit(b);
+  }
+  return 0;
+}
+
+static void PrintStage(const char *name, const uint64_t *before,
+                       const uint64_t *after) {
+  uint64_t count = 0;
+  const uint64_t p50 = DeltaPercentile(before, after, 0.50, &count);
+  const uint64_t p99 = DeltaPercentile(before, after, 0.99, &count);
+  printf("\"%s\":{\"count\":%llu,\"p50_us\":%llu,\"p99_us\":%llu}", name,
+         (unsigned long long)count, (unsigned long long)p50,
+         (unsigned long long)p99);
+}
+
+static void PrintDaemonDelta(const StatsSnapshot *before,
+                             const StatsSnapshot *after) {
+  printf("\"daemon\":{\"events\":%llu,\"voices\":%llu,\"merges\":%llu,"
+         "\"drops\":%llu,",
+         (unsigned long long)(after->events - before->events),
+         (unsigned long long)(after->voices - before->voices),
+         (unsigned long long)(after->merges - before->merges),
+         (unsigned long long)(after->drops - before->drops));
+  PrintStage("decode", before->decode, after->decode);
+  printf(",");
+  PrintStage("submit", before->submit, after->submit);
+  printf("}");
+}
+
+// ============================================================
+// WORKLOADS
+// ============================================================
+[[nodiscard]]
+static HANDLE ConnectEditor(void) {
+  while (true) {
+    HANDLE pipe = CreateFileA(PIPE_NAME, GENERIC_WRITE, 0, nullptr,
+                              OPEN_EXISTING, 0, nullptr);
+    if (pipe != INVALID_HANDLE_VALUE)
+      return pipe;
+    if (GetLastError() != ERROR_PIPE_BUSY ||
+        WaitNamedPipeA(PIPE_NAME, CONNECT_TIMEOUT_MS) == FALSE)
+      return INVALID_HANDLE_VALUE;
+  }
+}
+
+// Keys on an absolute schedule so a slow write doesn't stretch the run.
+// Every paste_every keys the next paste_size characters go out in one
+// write, the way a put or a macro replay arrives.
+static DWORD WINAPI TypingThread(void *parameter) {
+  Connection *connection = parameter;
+  HANDLE timer = CreateWaitableTimerExW(
+      nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+      TIMER_ALL_ACCESS);
+  if (timer == nullptr) {
+    timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+  }
+
+  BYTE burst[MAX_PASTE_SIZE * EVENT_FRAME_BYTES];
+  const int64_t start = NowTicks();
+  int64_t due = start;
+  size_t position = 0;
+  int keys = 0;
+  while (position < connection->trace_length && !connection->failed) {
+    const uint32_t now_ms =
+        (uint32_t)(TicksToMicros(NowTicks() - start) / 1000u);
+    if (connection->paste_every > 0 && keys > 0 &&
+        keys % connection->paste_every == 0) {
+      size_t count = 0;
+      while (count < (size_t)connection->paste_size &&
+             position < connection->trace_length) {
+        EncodeEvent(burst + count * EVENT_FRAME_BYTES,
+                    EventCode(connection->trace[position++]), now_ms);
+        count++;
+      }
+      if (WriteAll(connection, burst, (DWORD)(count * EVENT_FRAME_BYTES))) {
+        connection->sent += count;
+      }
+      keys++;
+      continue;
+    }
+
+    BYTE frame[EVENT_FRAME_BYTES];
+    EncodeEvent(frame, EventCode(connection->trace[position++]), now_ms);
+    if (WriteAll(connection, frame, sizeof(frame))) {
+      connection->sent++;
+    }
+    keys++;
+
+    due += connection->key_interval_ticks;
+    const int64_t wait = due - NowTicks();
+    if (wait > 0 && timer != nullptr) {
+      // Relative due times are negative, in 100 ns units
+      LARGE_INTEGER relative = {
+          .QuadPart = -(wait * 10000000 / qpc_ticks_per_second)};
+      if (SetWaitableTimer(timer, &relative, 0, nullptr, nullptr, FALSE)) {
+        WaitForSingleObject(timer, INFINITE);
+      }
+    }
+  }
+  if (timer != nullptr) {
+    CloseHandle(timer);
+  }
+  return 0;
+}
+
+static DWORD WINAPI FloodThread(void *parameter) {
+  Connection *connection = parameter;
+  BYTE frames[FLOOD_FRAME_EVENTS * EVENT_FRAME_BYTES];
+  for (int i = 0; i < FLOOD_FRAME_EVENTS; i++) {
+    EncodeEvent(frames + i * EVENT_FRAME_BYTES, 'k', 0);
+  }
+  int remaining = connection->flood;
+  while (remaining > 0 && !connection->failed) {
+    const int count =
+        remaining < FLOOD_FRAME_EVENTS ? remaining : FLOOD_FRAME_EVENTS;
+    if (WriteAll(connection, frames, (DWORD)(count * EVENT_FRAME_BYTES))) {
+      connection->sent += (uint64_t)count;
+    }
+    remaining -= count;
+  }
+  return 0;
+}
+
+// Runs one workload on every connection at once; returns the wall time
+[[nodiscard]]
+static int64_t RunPhase(Connection *connections, int count,
+                        LPTHREAD_START_ROUTINE body) {
+  HANDLE threads[MAX_CONNECTIONS];
+  const int64_t start = NowTicks();
+  for (int i = 0; i < count; i++) {
+    connections[i].sent = 0;
+    connections[i].slowest_write_us = 0;
+    threads[i] = CreateThread(nullptr, 0, body, &connections[i], 0, nullptr);
+    if (threads[i] == nullptr) {
+      connections[i].failed = true;
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    if (threads[i] != nullptr) {
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+    }
+  }
+  return NowTicks() - start;
+}
+
+static void PrintPhase(const char *name, const Connection *connections,
+                       int count, int64_t elapsed) {
+  uint64_t sent = 0;
+  uint64_t slowest_write_us = 0;
+  for (int i = 0; i < count; i++) {
+    sent += connections[i].sent;
+    if (connections[i].slowest_write_us > slowest_write_us) {
+      slowest_write_us = connections[i].slowest_write_us;
+    }
+  }
+  const double seconds = (double)elapsed / (double)qpc_ticks_per_second;
+  printf("\"%s\":{\"sent\":%llu,\"elapsed_ms\":%.2f,\"events_per_s\":%.0f,"
+         "\"slowest_write_us\":%llu,",
+         name, (unsigned long long)sent, seconds * 1000.0,
+         seconds > 0.0 ? (double)sent / seconds : 0.0,
+         (unsigned long long)slowest_write_us);
+}
+
+[[nodiscard]]
+static size_t LoadTrace(const char *path, char *out, size_t capacity) {
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr)
+    return 0;
+  const size_t length = fread(out, 1, capacity, file);
+  fclose(file);
+  return length;
+}
+
+static int CompareU64(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+  int connection_count = DEFAULT_CONNECTIONS;
+  int wpm = DEFAULT_WPM;
+  int paste_every = DEFAULT_PASTE_EVERY;
+  int paste_size = DEFAULT_PASTE_SIZE;
+  int flood = DEFAULT_FLOOD;
+  const char *trace_path = nullptr;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--connections") == 0) {
+      connection_count = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--wpm") == 0) {
+      wpm = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--paste-every") == 0) {
+      paste_every = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--paste-size") == 0) {
+      paste_size = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--flood") == 0) {
+      flood = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--trace") == 0) {
+      trace_path = argv[i + 1];
+    } else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (connection_count < 1 || connection_count > MAX_CONNECTIONS) {
+    connection_count = DEFAULT_CONNECTIONS;
+  }
+  if (wpm < 1) {
+    wpm = DEFAULT_WPM;
+  }
+  if (paste_size < 1 || paste_size > MAX_PASTE_SIZE) {
+    paste_size = DEFAULT_PASTE_SIZE;
+  }
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  qpc_ticks_per_second = frequency.QuadPart;
+
+  static char trace[MAX_TRACE_BYTES];
+  size_t trace_length = 0;
+  if (trace_path != nullptr) {
+    trace_length = LoadTrace(trace_path, trace, sizeof(trace));
+    if (trace_length == 0) {
+      fprintf(stderr, "Could not read trace %s\n", trace_path);
+      return EXIT_FAILURE;
+    }
+  } else {
+    trace_length = sizeof(DEFAULT_TRACE) - 1;
+    memcpy(trace, DEFAULT_TRACE, trace_length);
+  }
+
+  StatsSnapshot before_typing = {0};
+  if (!ReadStats(&before_typing)) {
+    fprintf(stderr, "No daemon stats on %s; start clicker first.\n",
+            STATS_PIPE_NAME);
+    return EXIT_FAILURE;
+  }
+
+  // Connect overhead, including the hello the daemon has to validate
+  static Connection connections[MAX_CONNECTIONS];
+  uint64_t connect_us[MAX_CONNECTIONS];
+  for (int i = 0; i < connection_count; i++) {
+    const int64_t start = NowTicks();
+    HANDLE pipe = ConnectEditor();
+    DWORD written = 0;
+    if (pipe == INVALID_HANDLE_VALUE ||
+        WriteFile(pipe, HELLO, sizeof(HELLO), &written, nullptr) == FALSE) {
+      fprintf(stderr, "Connection %d failed (Error %lu)\n", i,
+              GetLastError());
+      return EXIT_FAILURE;
+    }
+    connect_us[i] = TicksToMicros(NowTicks() - start);
+    connections[i] = (Connection){
+        .pipe = pipe,
+        .trace = trace,
+        .trace_length = trace_length,
+        .key_interval_ticks =
+            qpc_ticks_per_second * 60 / ((int64_t)wpm * CHARS_PER_WORD),
+        .paste_every = paste_every,
+        .paste_size = paste_size,
+        .flood = flood,
+    };
+  }
+  qsort(connect_us, (size_t)connection_count, sizeof(uint64_t), CompareU64);
+
+  StatsSnapshot after_typing = {0};
+  StatsSnapshot after_flood = {0};
+  bool stats_ok = true;
+  const int64_t typing_ticks =
+      RunPhase(connections, connection_count, TypingThread);
+  Sleep(DRAIN_MS);
+  stats_ok = stats_ok && ReadStats(&after_typing);
+  const int64_t flood_ticks =
+      RunPhase(connections, connection_count, FloodThread);
+  Sleep(DRAIN_MS);
+  stats_ok = stats_ok && ReadStats(&after_flood);
+
+  bool failed = !stats_ok;
+  for (int i = 0; i < connection_count; i++) {
+    failed = failed || connections[i].failed;
+    CloseHandle(connections[i].pipe);
+  }
+
+  printf("{\"connections\":%d,\"wpm\":%d,\"paste_every\":%d,"
+         "\"paste_size\":%d,\"trace_chars\":%zu,",
+         connection_count, wpm, paste_every, paste_size, trace_length);
+  printf("\"connect\":{\"p50_us\":%llu,\"max_us\":%llu},",
+         (unsigned long long)connect_us[connection_count / 2],
+         (unsigned long long)connect_us[connection_count - 1]);
+  PrintPhase("typing", connections, connection_count, typing_ticks);
+  PrintDaemonDelta(&before_typing, &after_typing);
+  printf("},");
+  PrintPhase("flood", connections, connection_count, flood_ticks);
+  PrintDaemonDelta(&after_typing, &after_flood);
+  printf("},\"ok\":%s}\n", failed ? "false" : "true");
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
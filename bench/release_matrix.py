@@ -0,0 +1,271 @@
+"""Builds the clicker daemon in each release configuration and compares them.
+
+Every variant gets its own build directory under --out. PGO variants are
+configured twice: an instrumented build replays the training trace through
+clicker_pgo_train, then the same directory is reconfigured to use the merged
+profile. Each finished daemon is measured for:
+  - binary size on disk
+  - startup: launch -> event pipe accepting (median of --runs launches)
+  - p99 latency: the daemon's own read -> decode and read -> device submit
+    histograms, from a --replay of the trace
+
+Without --trace a typing trace is synthesized: a code snippet typed at
+120 WPM with a paste burst every 80 keys, like clicker_bench's workload.
+
+Usage: python bench/release_matrix.py --source . --out build/release-matrix
+       [--generator G] [--compiler C] [--trace file] [--runs N] [--speed X]
+       [--only name,name]
+"""
+import argparse
+import json
+import os
+import socket
+import statistics
+import struct
+import subprocess
+import sys
+import time
+
+IS_WINDOWS = os.name == "nt"
+EXE_NAME = "clicker.exe" if IS_WINDOWS else "clicker"
+
+# name -> cache entries; PGO variants are the ones with "pgo" in the name
+VARIANTS = [
+    ("baseline", {}),
+    ("lto", {"CLICKER_LTO": "ON"}),
+    ("lto-native", {"CLICKER_LTO": "ON", "CLICKER_ARCH": "native"}),
+    ("lto-pgo", {"CLICKER_LTO": "ON"}),
+    ("lto-pgo-native", {"CLICKER_LTO": "ON", "CLICKER_ARCH": "native"}),
+]
+if IS_WINDOWS:
+    VARIANTS.append(("lto-pgo-native-static", {
+        "CLICKER_LTO": "ON", "CLICKER_ARCH": "native",
+        "CLICKER_STATIC_CRT": "ON",
+    }))
+
+# Trace format (clicker.c, TRACE TYPES): 16-byte header with the tick rate,
+# then ticks u64 | code | intensity | pan | client per event (one client here)
+TRACE_TICKS_PER_SECOND = 1_000_000
+TRACE_SNIPPET = (
+    "static void Render(float *out, uint32_t frames) {\n"
+    "  for (uint32_t i = 0; i < frames; i++) {\n"
+    "    out[i] = voices[i % count].gain * sample[i];\n"
+    "  }\n"
+    "}\n"
+)
+TRACE_WPM = 120
+TRACE_KEYS = 240
+TRACE_PASTE_EVERY = 80
+TRACE_PASTE_SIZE = 200
+TRACE_COLUMNS = 120
+PAN_POSITIONS = 65
+
+STARTUP_TIMEOUT_S = 2.0
+
+
+def run(command, **kwargs):
+    print("[*] " + " ".join(command))
+    result = subprocess.run(command, **kwargs)
+    if result.returncode != 0:
+        print(f"[!] Failed ({result.returncode}): {command[0]}")
+        sys.exit(1)
+    return result
+
+
+def event_code(char):
+    return {" ": ord("s"), "\n": ord("e")}.get(char, ord("k"))
+
+
+def write_trace(path):
+    """Synthesizes typing with paste bursts; a burst shares one tick."""
+    key_ticks = TRACE_TICKS_PER_SECOND * 60 // (TRACE_WPM * 5)
+    records = []
+    ticks = 0
+    column = 0
+    position = 0
+
+    def record(char):
+        nonlocal column, position
+        pan = 1 + (column * (PAN_POSITIONS - 1) + (TRACE_COLUMNS - 1) // 2) \
+            // (TRACE_COLUMNS - 1)
+        column = 0 if char == "\n" else min(column + 1, TRACE_COLUMNS - 1)
+        position += 1
+        records.append(struct.pack("<QBBBB", ticks, event_code(char), 255,
+                                   pan, 0))
+
+    for key in range(TRACE_KEYS):
+        if key > 0 and key % TRACE_PASTE_EVERY == 0:
+            for _ in range(TRACE_PASTE_SIZE):
+                record(TRACE_SNIPPET[position % len(TRACE_SNIPPET)])
+        else:
+            record(TRACE_SNIPPET[position % len(TRACE_SNIPPET)])
+        ticks += key_ticks
+
+    header = b"NCTR" + bytes([1, 0, 0, 0]) + \
+        struct.pack("<Q", TRACE_TICKS_PER_SECOND)
+    with open(path, "wb") as trace:
+        trace.write(header + b"".join(records))
+
+
+def find_binary(build_dir, name):
+    for folder in ["", "Release"]:
+        path = os.path.join(build_dir, folder, name)
+        if os.path.exists(path):
+            return path
+    print(f"[!] No {name} in {build_dir}")
+    sys.exit(1)
+
+
+def build_variant(args, name, entries, trace):
+    build_dir = os.path.abspath(os.path.join(args.out, name))
+    configure = ["cmake", "-S", args.source, "-B", build_dir,
+                 "-DCMAKE_BUILD_TYPE=Release"]
+    if args.generator:
+        configure += ["-G", args.generator]
+    if args.compiler:
+        configure.append(f"-DCMAKE_C_COMPILER={args.compiler}")
+    configure += [f"-D{key}={value}" for key, value in entries.items()]
+    build = ["cmake", "--build", build_dir, "--config", "Release"]
+
+    if "pgo" in name:
+        run(configure + ["-DCLICKER_PGO=instrument",
+                         f"-DCLICKER_PGO_TRACE={trace}"])
+        run(build + ["--target", "clicker_pgo_train"])
+        run(configure + ["-DCLICKER_PGO=use"])
+    else:
+        run(configure + ["-DCLICKER_PGO="])
+    run(build + ["--target", "clicker"])
+    return build_dir
+
+
+def daemon_socket():
+    runtime = (os.environ.get("XDG_RUNTIME_DIR") or
+               os.environ.get("TMPDIR") or "/tmp").rstrip("/")
+    return f"{runtime}/nvim_clack-{os.getuid()}.sock"
+
+
+def daemon_listening():
+    if IS_WINDOWS:
+        return os.path.exists(r"\\.\pipe\nvim_clack")
+    probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        probe.connect(daemon_socket())
+        return True
+    except OSError:
+        return False
+    finally:
+        probe.close()
+
+
+def startup_ms_windows(build_dir, exe, runs):
+    """clicker_startup_bench's median; it exits 1 when over budget."""
+    run(["cmake", "--build", build_dir, "--config", "Release",
+         "--target", "clicker_startup_bench"])
+    bench = find_binary(build_dir, "clicker_startup_bench.exe")
+    output = subprocess.run([bench, exe, str(runs)], capture_output=True,
+                            text=True).stdout
+    for line in output.splitlines():
+        if "pipe ready" in line:
+            return float(line.split()[2])
+    return None
+
+
+def startup_ms_posix(exe, runs):
+    """Launch -> first accepted connect on the event socket."""
+    path = daemon_socket()
+    samples = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        daemon = subprocess.Popen([exe], stdout=subprocess.DEVNULL,
+                                  stderr=subprocess.DEVNULL)
+        ready = None
+        while ready is None and time.perf_counter() - start < STARTUP_TIMEOUT_S:
+            probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            try:
+                probe.connect(path)
+                ready = time.perf_counter() - start
+            except OSError:
+                if daemon.poll() is not None:
+                    break  # Died during startup
+            finally:
+                probe.close()
+        daemon.terminate()
+        daemon.wait()
+        if ready is None:
+            return None
+        samples.append(ready * 1000.0)
+    return statistics.median(samples)
+
+
+def replay_p99(exe, trace, speed):
+    """read -> decode and read -> submit p99 from the replay's stats."""
+    output = subprocess.run([exe, "--replay", trace, "--speed", str(speed)],
+                            capture_output=True, text=True).stdout
+    for line in reversed(output.splitlines()):
+        if line.startswith('{"uptime_ms"'):
+            stats = json.loads(line)
+            return stats["decode"]["p99_us"], stats["submit"]["p99_us"]
+    return None, None
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--source", default=".")
+    parser.add_argument("--out", default=os.path.join("build", "release-matrix"))
+    parser.add_argument("--generator")
+    parser.add_argument("--compiler")
+    parser.add_argument("--trace")
+    parser.add_argument("--runs", type=int, default=10)
+    parser.add_argument("--speed", type=float, default=1.0)
+    parser.add_argument("--only", help="comma-separated variant names")
+    args = parser.parse_args()
+    args.source = os.path.abspath(args.source)
+    os.makedirs(args.out, exist_ok=True)
+
+    if daemon_listening():
+        print("[!] A daemon is already listening; stop it first.")
+        sys.exit(1)
+
+    trace = args.trace
+    if trace is None:
+        trace = os.path.abspath(os.path.join(args.out, "typing.nctr"))
+        write_trace(trace)
+    trace = os.path.abspath(trace)
+
+    wanted = set(args.only.split(",")) if args.only else None
+    results = []
+    for name, entries in VARIANTS:
+        if wanted is not None and name not in wanted:
+            continue
+        build_dir = build_variant(args, name, entries, trace)
+        exe = find_binary(build_dir, EXE_NAME)
+        startup = (startup_ms_windows(build_dir, exe, args.runs) if IS_WINDOWS
+                   else startup_ms_posix(exe, args.runs))
+        decode_p99, submit_p99 = replay_p99(exe, trace, args.speed)
+        results.append({
+            "variant": name,
+            "size_bytes": os.path.getsize(exe),
+            "startup_ms": startup,
+            "decode_p99_us": decode_p99,
+            "submit_p99_us": submit_p99,
+        })
+
+    def cell(value, fmt):
+        return "-" if value is None else format(value, fmt)
+
+    print(f"\n{'variant':<24}{'size KB':>10}{'startup ms':>12}"
+          f"{'decode p99':>12}{'submit p99':>12}")
+    for r in results:
+        print(f"{r['variant']:<24}{r['size_bytes'] / 1024:>10.1f}"
+              f"{cell(r['startup_ms'], '.2f'):>12}"
+              f"{cell(r['decode_p99_us'], 'd'):>10}us"
+              f"{cell(r['submit_p99_us'], 'd'):>10}us")
+
+    report = os.path.join(args.out, "report.json")
+    with open(report, "w") as out:
+        json.dump(results, out, indent=2)
+    print(f"\n[+] Wrote {report}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,191 @@
+// Startup budget check for clicker.exe. Launches the daemon detached, the
+// way init.lua does, and measures:
+//   - CreateProcess -> first successful pipe connect (budget: 5 ms)
+//   - working set once listening, before any event (budget: 2 MB)
+//   - working set after the first click woke the audio engine (reported)
+// Exits non-zero when a median is over budget.
+//
+// Usage: clicker_startup_bench <path-to-clicker.exe> [runs]
+#define WIN32_LEAN_AND_MEAN
+
+// clang-format off
+#include <windows.h>
+#include <psapi.h>
+// clang-format on
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *const PIPE_NAME = "\\\\.\\pipe\\nvim_clack";
+static constexpr int DEFAULT_RUNS = 20;
+static constexpr int MAX_RUNS = 200;
+static constexpr int64_t READY_TIMEOUT_MS = 2000;
+static constexpr DWORD SETTLE_MS = 50;
+static constexpr DWORD AUDIO_WARMUP_MS = 250;
+static constexpr uint64_t STARTUP_BUDGET_US = 5000;
+static constexpr uint64_t IDLE_BUDGET_BYTES = 2u * 1024u * 1024u;
+
+// Protocol v1 hello followed by one full-intensity click
+static const BYTE FIRST_CLICK[] = {'N', 'C', 'L', 'K', 1, 0,
+                                   6,   'k', 0,   0,   0, 0, 255};
+
+typedef struct {
+  uint64_t ready_us;
+  uint64_t idle_bytes;
+  uint64_t active_bytes;
+} RunResult;
+
+static int64_t qpc_ticks_per_second = 1;
+
+[[nodiscard]]
+static int64_t NowTicks(void) {
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return now.QuadPart;
+}
+
+[[nodiscard]]
+static uint64_t TicksToMicros(int64_t ticks) {
+  return (uint64_t)ticks * 1000000u / (uint64_t)qpc_ticks_per_second;
+}
+
+[[nodiscard]]
+static uint64_t WorkingSetBytes(HANDLE process) {
+  PROCESS_MEMORY_COUNTERS counters = {.cb = sizeof(counters)};
+  if (K32GetProcessMemoryInfo(process, &counters, sizeof(counters)) == FALSE)
+    return 0;
+  return counters.WorkingSetSize;
+}
+
+// Spins on the pipe name until the daemon accepts us. Returns
+// INVALID_HANDLE_VALUE if it exits or takes longer than READY_TIMEOUT_MS.
+[[nodiscard]]
+static HANDLE WaitForPipe(HANDLE process, int64_t start) {
+  const int64_t deadline =
+      start + (READY_TIMEOUT_MS * qpc_ticks_per_second / 1000);
+
+  while (NowTicks() < deadline) {
+    HANDLE pipe = CreateFileA(PIPE_NAME, GENERIC_WRITE, 0, nullptr,
+                              OPEN_EXISTING, 0, nullptr);
+    if (pipe != INVALID_HANDLE_VALUE)
+      return pipe;
+
+    if (GetLastError() == ERROR_PIPE_BUSY) {
+      WaitNamedPipeA(PIPE_NAME, 1);
+    } else if (WaitForSingleObject(process, 0) == WAIT_OBJECT_0) {
+      break; // Daemon died during startup
+    } else {
+      SwitchToThread();
+    }
+  }
+  return INVALID_HANDLE_VALUE;
+}
+
+[[nodiscard]]
+static bool RunOnce(const char *exe, RunResult *result) {
+  char command_line[MAX_PATH + 2];
+  snprintf(command_line, sizeof(command_line), "\"%s\"", exe);
+
+  STARTUPINFOA startup = {.cb = sizeof(startup)};
+  PROCESS_INFORMATION info = {0};
+  const int64_t start = NowTicks();
+  if (CreateProcessA(exe, command_line, nullptr, nullptr, FALSE,
+                     DETACHED_PROCESS, nullptr, nullptr, &startup,
+                     &info) == FALSE) {
+    printf("CreateProcess failed (Error %lu)\n", GetLastError());
+    return false;
+  }
+
+  HANDLE pipe = WaitForPipe(info.hProcess, start);
+  const int64_t ready = NowTicks();
+  bool ok = pipe != INVALID_HANDLE_VALUE;
+
+  if (ok) {
+    result->ready_us = TicksToMicros(ready - start);
+    Sleep(SETTLE_MS);
+    result->idle_bytes = WorkingSetBytes(info.hProcess);
+
+    DWORD written = 0;
+    ok = WriteFile(pipe, FIRST_CLICK, sizeof(FIRST_CLICK), &written,
+                   nullptr) != FALSE;
+    Sleep(AUDIO_WARMUP_MS);
+    result->active_bytes = WorkingSetBytes(info.hProcess);
+    CloseHandle(pipe);
+  } else {
+    printf("Daemon never accepted a connection\n");
+  }
+
+  TerminateProcess(info.hProcess, 0);
+  WaitForSingleObject(info.hProcess, INFINITE);
+  CloseHandle(info.hThread);
+  CloseHandle(info.hProcess);
+  return ok;
+}
+
+static int CompareU64(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Sorts in place; returns the median, writes the maximum
+[[nodiscard]]
+static uint64_t Median(uint64_t *values, int count, uint64_t *max) {
+  qsort(values, (size_t)count, sizeof(uint64_t), CompareU64);
+  *max = values[count - 1];
+  return values[count / 2];
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s <path-to-clicker.exe> [runs]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+  if (runs < 1 || runs > MAX_RUNS) {
+    runs = DEFAULT_RUNS;
+  }
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  qpc_ticks_per_second = frequency.QuadPart;
+
+  if (GetFileAttributesA(PIPE_NAME) != INVALID_FILE_ATTRIBUTES) {
+    printf("A daemon is already listening on %s; stop it first.\n",
+           PIPE_NAME);
+    return EXIT_FAILURE;
+  }
+
+  static uint64_t ready_us[MAX_RUNS];
+  static uint64_t idle_bytes[MAX_RUNS];
+  static uint64_t active_bytes[MAX_RUNS];
+  for (int i = 0; i < runs; i++) {
+    RunResult result = {0};
+    if (!RunOnce(argv[1], &result))
+      return EXIT_FAILURE;
+    ready_us[i] = result.ready_us;
+    idle_bytes[i] = result.idle_bytes;
+    active_bytes[i] = result.active_bytes;
+  }
+
+  uint64_t ready_max = 0;
+  uint64_t idle_max = 0;
+  uint64_t active_max = 0;
+  const uint64_t ready = Median(ready_us, runs, &ready_max);
+  const uint64_t idle = Median(idle_bytes, runs, &idle_max);
+  const uint64_t active = Median(active_bytes, runs, &active_max);
+
+  const bool ready_ok = ready <= STARTUP_BUDGET_US;
+  const bool idle_ok = idle <= IDLE_BUDGET_BYTES;
+  printf("%d runs (median / max)\n", runs);
+  printf("  pipe ready    %6.2f / %6.2f ms   budget %.2f ms  %s\n",
+         ready / 1000.0, ready_max / 1000.0, STARTUP_BUDGET_US / 1000.0,
+         ready_ok ? "ok" : "OVER");
+  printf("  idle WS       %6.2f / %6.2f MB   budget %.2f MB  %s\n",
+         idle / 1048576.0, idle_max / 1048576.0,
+         IDLE_BUDGET_BYTES / 1048576.0, idle_ok ? "ok" : "OVER");
+  printf("  after 1 click %6.2f / %6.2f MB\n", active / 1048576.0,
+         active_max / 1048576.0);
+  return ready_ok && idle_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,24 +1,30 @@
 import subprocess
 import os
-import time
 import sys
 
+def retire_running_binary(exe_path):
+    """Moves the (possibly running) exe aside so the linker can write a new one.
+    Windows refuses to overwrite a running image but happily renames it."""
+    old_path = exe_path + ".old"
+    try:
+        os.remove(old_path)  # Left over from the previous cycle
+    except OSError:
+        pass  # Missing, or that old daemon is somehow still alive
+    try:
+        os.replace(exe_path, old_path)
+    except OSError:
+        pass  # Nothing built yet
+
 def manage_clicker():
-    exe_name = "clicker.exe"
+    exe_name = "clicker.exe" if os.name == "nt" else "clicker"
     build_dir = "build"
     
     print(f"--- Automated Build Cycle for {exe_name} ---")
 
-    # 1. Kill the existing process
-    print(f"[*] Terminating existing {exe_name} instances...")
-    subprocess.run(
-        ["taskkill", "/F", "/IM", exe_name, "/T"], 
-        stdout=subprocess.DEVNULL, 
-        stderr=subprocess.DEVNULL
-    )
-    
-    # Wait for file handle release
-    time.sleep(0.5)
+    # 1. Move the running binary out of the way; it keeps serving until step 3
+    print(f"[*] Retiring current {exe_name} (daemon keeps running)...")
+    for folder in ["", build_dir, os.path.join(build_dir, "Release")]:
+        retire_running_binary(os.path.join(os.getcwd(), folder, exe_name))
 
     # 2. Run the CMake Build
     print("[*] Running CMake build...")
@@ -50,17 +56,20 @@ def manage_clicker():
         
         # FIX: Removed CREATE_NEW_CONSOLE conflict.
         # Added DEVNULL redirection so the daemon doesn't try to use this terminal's IO.
+        # --takeover: the new daemon starts listening, then asks the old
+        # one to exit over the control pipe. No restart gap, no taskkill.
         subprocess.Popen(
-            [target_exe],
+            [target_exe, "--takeover"],
             stdout=subprocess.DEVNULL,
             stderr=subprocess.DEVNULL,
             stdin=subprocess.DEVNULL,
-            creationflags=subprocess.DETACHED_PROCESS,
+            creationflags=subprocess.DETACHED_PROCESS if os.name == "nt" else 0,
+            start_new_session=os.name != "nt",
             close_fds=True
         )
         print("[+] Success! Daemon is detached and running.")
     else:
-        print("[!] Could not find compiled clicker.exe.")
+        print(f"[!] Could not find compiled {exe_name}.")
 
 if __name__ == "__main__":
     manage_clicker()
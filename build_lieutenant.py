@@ -1,72 +1,31 @@
-import wave
-import struct
-import math
 import os
 import subprocess
-import time
 import sys
 
 # ============================================================
-# 1. THE COOK: AUDIO GENERATION
+# 1. THE BUILD: COMPILATION & DAEMON MANAGEMENT
 # ============================================================
 
-def generate_beep(filename, start_freq, end_freq, duration_ms, volume=0.2):
-    """Generates a vintage square-wave beep with pitch decay."""
-    sample_rate = 44100
-    num_samples = int(sample_rate * (duration_ms / 1000.0))
-    
-    os.makedirs(os.path.dirname(filename), exist_ok=True)
-
-    with wave.open(filename, 'w') as f:
-        f.setnchannels(1)
-        f.setsampwidth(2)
-        f.setframerate(sample_rate)
-        
-        for i in range(num_samples):
-            t = i / sample_rate
-            progress = i / num_samples
-            
-            # Pitch Decay (Chirp)
-            current_freq = start_freq + (end_freq - start_freq) * progress
-            phase = 2 * math.pi * current_freq * t
-            
-            # Square wave logic
-            value = 32767 * volume * (1 if math.sin(phase) > 0 else -1)
-            
-            # Attack and Decay Envelope
-            attack_samples = int(sample_rate * 0.002)
-            if i < attack_samples:
-                envelope = i / attack_samples
-            else:
-                envelope = math.exp(-progress * 10) # Natural exponential decay
-            
-            f.writeframes(struct.pack('<h', int(value * envelope)))
-
-def cook_sounds():
-    """Defines and generates the sound palette."""
-    print("[*] Cooking sound palette...")
-    palette = {
-        'sounds/click.wav':  (1200, 800, 25, 0.15),
-        'sounds/space.wav':  (600, 400, 45, 0.20),
-        'sounds/enter.wav':  (300, 150, 100, 0.25),
-    }
-    for path, params in palette.items():
-        generate_beep(path, *params)
-    print("[+] Audio assets cooked.")
-
-# ============================================================
-# 2. THE BUILD: COMPILATION & DAEMON MANAGEMENT
-# ============================================================
+def retire_running_binary(exe_path):
+    """Renames the running exe so the build can replace it (Windows allows
+    renaming a running image, not overwriting it)."""
+    old_path = exe_path + ".old"
+    try:
+        os.remove(old_path)
+    except OSError:
+        pass
+    try:
+        os.replace(exe_path, old_path)
+    except OSError:
+        pass
 
 def build_and_start():
     exe_name = "clicker.exe"
     build_dir = "build"
     
-    print(f"[*] Terminating existing {exe_name} instances...")
-    subprocess.run(["taskkill", "/F", "/IM", exe_name, "/T"], 
-                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
-    
-    time.sleep(0.5) # Wait for Windows to release file handles
+    print(f"[*] Retiring current {exe_name} (daemon keeps running)...")
+    for folder in ["", build_dir, os.path.join(build_dir, "Release")]:
+        retire_running_binary(os.path.join(os.getcwd(), folder, exe_name))
     if not os.path.exists(os.path.join(build_dir, "CMakeCache.txt")):
         print("[*] Initializing CMake configuration (Clang + Ninja)...")
         os.makedirs(build_dir, exist_ok=True)
@@ -76,7 +35,8 @@ def build_and_start():
             "cmake", "-S", ".", "-B", build_dir,
             "-G", "Ninja",
             "-DCMAKE_C_COMPILER=clang", # or "clang" depending on your PATH
-            "-DCMAKE_BUILD_TYPE=Release"
+            "-DCMAKE_BUILD_TYPE=Release",
+            "-DCLICKER_MINIMAL=ON" # LTO + static CRT: fast editor startup
         ]
         
         config_result = subprocess.run(config_cmd)
@@ -102,8 +62,9 @@ def build_and_start():
 
     if target_exe:
         print(f"[*] Launching {target_exe}...")
+        # Hands off from the old daemon without dropping the pipe
         subprocess.Popen(
-            [target_exe],
+            [target_exe, "--takeover"],
             stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, stdin=subprocess.DEVNULL,
             creationflags=subprocess.DETACHED_PROCESS,
             close_fds=True
@@ -113,10 +74,9 @@ def build_and_start():
         print("[!] clicker.exe not found.")
 
 # ============================================================
-# 3. ENTRY POINT
+# 2. ENTRY POINT
 # ============================================================
 
 if __name__ == "__main__":
-    # If run normally, do the full cycle
-    cook_sounds()
+    # Sounds are synthesized by the daemon; sounds/*.wav are optional overrides
     build_and_start()
@@ -1,212 +1,2576 @@
-#define WIN32_LEAN_AND_MEAN
-
-// clang-format off
-#include <windows.h>
-#include <mmsystem.h>
-// clang-format on
+// Portable core: wire protocol, rate limiting, the voice mixer, stats and
+// the command line. Everything that touches the OS lives behind platform.h.
+// Built twice: as the clicker daemon, and with CLICKER_LIBRARY as the
+// clicker_core shared library (see clicker_api.h).
+#include "clicker_api.h"
+#include "mpsc_ring.h"
+#include "platform.h"
 
+#include <math.h>
+#include <stdarg.h>
 #include <stdatomic.h>
-#include <stddef.h> // for unreachable()
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-// Link with winmm.lib
-#pragma comment(lib, "winmm.lib")
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // ============================================================
 // GLOBALS
 // ============================================================
-static atomic_bool is_shaking = false;
+static int64_t clock_ticks_per_second = 1; // Set once in main()
+static bool log_enabled = false;           // Set once in main()
+bool takeover_requested = false;
 
 // ============================================================
 // CONSTANTS & MACROS
 // ============================================================
-static const char *const PIPE_NAME = "\\\\.\\pipe\\nvim_clack";
-static constexpr DWORD PIPE_BUFFER_SIZE = 1024;
-static constexpr DWORD PIPE_MAX_INST = PIPE_UNLIMITED_INSTANCES;
-static constexpr DWORD READ_BUFFER_SIZE = 1;
-static constexpr DWORD RETRY_DELAY_MS = 1000;
-static constexpr DWORD IDLE_YIELD_MS = 10;
+static constexpr int SHAKE_DEFAULT_AMPLITUDE_PX = 15;
+static constexpr int SHAKE_DEFAULT_DURATION_MS = 300;
+static constexpr int SHAKE_MAX_DURATION_MS = 2000;
+static constexpr int SHAKE_MAX_AMPLITUDE_PX = 200;
+static constexpr double REPLAY_MIN_SPEED = 0.01;
+static constexpr double REPLAY_MAX_SPEED = 100.0;
+
+// ============================================================
+// WIRE PROTOCOL (v1)
+// ============================================================
+// A connection that opens with the magic "NCLK" speaks frames and stays
+// open for the editor's lifetime. Anything else is the legacy stream of
+// one raw byte per event, still accepted so old configs keep clacking.
+//
+//   Hello : 'N' 'C' 'L' 'K' | version u8 | hello_len u8 | hello_len bytes
+//   Event : len u8 | code u8 | timestamp_ms u32 LE | [intensity u8] |
+//           [col u16 LE | row u16 LE | columns u16 LE | lines u16 LE] | ...
+//
+// Hello fields, each optional from the end: client pid u32 LE, then the
+// window effects should target as u64 LE (the console HWND on Windows).
+// An event's optional position is the cursor's screen cell and the size of
+// the grid it sits in; the mixer pans the click by the column.
+// `len` counts the bytes after itself. Fields newer clients append (to the
+// hello or to an event) are skipped, so the format can grow without a bump.
+static const uint8_t PROTOCOL_MAGIC[4] = {'N', 'C', 'L', 'K'};
+static constexpr uint8_t PROTOCOL_VERSION = 1;
+static constexpr uint32_t HELLO_HEADER_BYTES = 6;
+static constexpr uint8_t HELLO_PID_LEN = 4;
+static constexpr uint8_t HELLO_WINDOW_LEN = 12; // pid + window
+static constexpr uint8_t EVENT_MIN_LEN = 5; // code + timestamp
+static constexpr uint8_t EVENT_INTENSITY_LEN = 6;
+static constexpr uint8_t EVENT_POSITION_LEN = 14; // + cell and grid size
+static constexpr uint8_t INTENSITY_FULL = 255;
+
+ShakeConfig shake_config = {
+    .duration_ms = SHAKE_DEFAULT_DURATION_MS,
+    .amplitude_px = SHAKE_DEFAULT_AMPLITUDE_PX,
+    .style = SHAKE_STYLE_MOVE,
+};
+
+// ============================================================
+// SOUND BANK (Resident decoded PCM, validated once at startup)
+// ============================================================
+typedef enum {
+  SOUND_SLOT_CLICK,
+  SOUND_SLOT_SPACE,
+  SOUND_SLOT_ENTER,
+  SOUND_SLOT_COUNT
+} SoundSlotId;
+
+// Mono float PCM at the file's own rate. One trailing zero frame is kept
+// past `frames` so the mixer can interpolate without a bounds branch.
+typedef struct {
+  uint32_t frames;
+  uint32_t sample_rate;
+  float samples[];
+} SoundBuffer;
+
+// Buffers move one way: watcher -> pending -> live (render thread) ->
+// draining (until no voice reads it) -> retired -> freed by the watcher.
+typedef struct {
+  const char *path;
+  uint64_t stamp;                 // Serialized by ReloadSoundBank's caller
+  _Atomic(SoundBuffer *) pending; // Freshly decoded, not yet adopted
+  _Atomic(SoundBuffer *) retired; // Unreferenced, waiting to be freed
+  SoundBuffer *live;              // Render thread only
+  SoundBuffer *draining;          // Render thread only
+} SoundSlot;
+
+typedef struct {
+  uint16_t channels;
+  uint16_t bits;
+  uint32_t sample_rate;
+  const uint8_t *samples;
+  uint32_t sample_bytes;
+} WavInfo;
+
+static constexpr uint32_t SOUND_MAX_FILE_BYTES = 4u * 1024u * 1024u;
+static constexpr uint32_t RIFF_HEADER_BYTES = 12;
+static constexpr uint32_t CHUNK_HEADER_BYTES = 8;
+static constexpr uint32_t FMT_CHUNK_MIN_BYTES = 16;
+static constexpr uint16_t WAV_FORMAT_PCM = 1;
+
+static SoundSlot sound_bank[SOUND_SLOT_COUNT] = {
+    [SOUND_SLOT_CLICK] = {.path = SOUND_CLICK},
+    [SOUND_SLOT_SPACE] = {.path = SOUND_SPACE},
+    [SOUND_SLOT_ENTER] = {.path = SOUND_ENTER},
+};
+
+// ============================================================
+// EVENT CLASSIFICATION (Table-driven, one decision per read)
+// ============================================================
+// What one event byte does. 256 of these make the dispatch table, sixteen
+// to a cache line, so classifying a byte is a single load. The table comes
+// from the event map file (see EVENT MAP) and is swapped whole on reload.
+static constexpr uint8_t EFFECT_SHAKE = 1u << 0;
+static constexpr uint8_t EFFECT_FLASH = 1u << 1;
+static constexpr uint8_t EFFECT_PULSE = 1u << 2; // Intensity bus burst only
+static constexpr uint8_t EVENT_GAIN_UNITY = 128;
+static constexpr uint8_t EVENT_DEFAULT_JITTER = 4; // +/- 4% per keystroke
+static constexpr uint8_t LANE_SILENT = SOUND_SLOT_COUNT; // Effects only
+
+static_assert(LANE_SILENT + 1 == EVENT_LANE_COUNT);
+
+typedef struct {
+  uint8_t lane;    // Sound slot that plays, or LANE_SILENT
+  uint8_t gain;    // 1/128ths, so EVENT_GAIN_UNITY plays as sent
+  uint8_t jitter;  // Pitch jitter of synthesized voices, +/- percent
+  uint8_t effects; // EFFECT_* bits
+} EventAction;
+
+typedef struct {
+  alignas(64) EventAction actions[256];
+} EventTable;
+
+static_assert(sizeof(EventAction) == 4);
+static_assert(sizeof(EventTable) == 16 * 64);
+
+// Everything one read delivered, folded per lane. A paste that floods the
+// pipe collapses into at most one voice per sound instead of hundreds.
+typedef struct {
+  uint32_t counts[EVENT_LANE_COUNT];
+  float peak_level[EVENT_LANE_COUNT]; // Loudest intensity x table gain
+  uint8_t jitter[EVENT_LANE_COUNT];   // Widest jitter any event asked for
+  uint8_t pan[EVENT_LANE_COUNT];      // Newest positioned event's pan
+  uint8_t effects;                    // Every event's effects, OR'd
+} EventBatch;
+
+// Without a map file: every byte clicks; 's', 'e', 'w' and 'x' are what
+// init.lua sends for space, enter, a save and the shake on <leader>w.
+static const EventAction DEFAULT_EVENT_ACTION = {
+    .lane = SOUND_SLOT_CLICK,
+    .gain = EVENT_GAIN_UNITY,
+    .jitter = EVENT_DEFAULT_JITTER,
+};
+
+static const struct {
+  uint8_t code;
+  EventAction action;
+} BUILTIN_EVENT_ACTIONS[] = {
+    {'s', {SOUND_SLOT_SPACE, EVENT_GAIN_UNITY, EVENT_DEFAULT_JITTER, 0}},
+    {'e', {SOUND_SLOT_ENTER, EVENT_GAIN_UNITY, EVENT_DEFAULT_JITTER, 0}},
+    {'w', {SOUND_SLOT_ENTER, EVENT_GAIN_UNITY, EVENT_DEFAULT_JITTER,
+           EFFECT_PULSE}},
+    {'x', {SOUND_SLOT_ENTER, EVENT_GAIN_UNITY, EVENT_DEFAULT_JITTER,
+           EFFECT_SHAKE}},
+};
+
+// Two tables: readers hold the published one for the length of a batch,
+// and reloads (a human saving a file) are far apart, so the spare one is
+// always free to rebuild.
+static EventTable event_tables[2];
+static _Atomic(const EventTable *) event_table = &event_tables[0];
+static int event_table_spare = 1;  // Serialized by ReloadSoundBank's caller
+static uint64_t event_map_stamp = 0; // Same
+static const char *event_map_path = EVENT_MAP;
+
+// A burst plays a little louder per doubling, capped so it never spikes
+static constexpr float BURST_GAIN_PER_DOUBLING = 0.15f;
+static constexpr float BURST_GAIN_MAX = 1.6f;
+
+// ============================================================
+// RATE LIMITING (Per client, per sound)
+// ============================================================
+// Clicks and spaces go through a token bucket plus a short coalescing
+// window; extra events inside either one merge into the voice already
+// playing (louder) instead of starting another. Enter is never rate
+// limited: missing one of those is noticeable, missing a click isn't.
+typedef enum {
+  ADMIT_START, // Worth a voice of its own
+  ADMIT_MERGE, // Fold into the voice already playing
+} Admission;
+
+static const bool LANE_RATE_LIMITED[EVENT_LANE_COUNT] = {
+    [SOUND_SLOT_CLICK] = true,
+    [SOUND_SLOT_SPACE] = true,
+};
+
+static constexpr float TOKEN_BUCKET_CAPACITY = 6.0f;
+static constexpr float TOKEN_REFILL_PER_SECOND = 20.0f; // ~240 WPM of voices
+static constexpr int64_t COALESCE_WINDOW_MS = 30;
+
+// ============================================================
+// AUDIO ENGINE TYPES (Voice mixer; the device is the backend's)
+// ============================================================
+typedef enum {
+  TRIGGER_START, // Allocate (or steal) a voice
+  TRIGGER_MERGE, // Boost the youngest voice of the slot, if still playing
+} TriggerKind;
+
+typedef struct {
+  uint8_t slot;
+  uint8_t kind;
+  uint8_t jitter; // Pitch jitter, +/- percent
+  uint8_t pan;    // ClackEvent pan; starts only
+  float gain;     // Start: the voice's level. Merge: the events' peak level
+  uint32_t count; // Events this trigger stands for
+  int64_t read_ticks; // Clock time the transport read completed
+} VoiceTrigger;
+
+// One synthesized sound: a square wave swept linearly from start to end
+// frequency, with a short linear attack and an exponential decay.
+typedef struct {
+  float start_hz;
+  float end_hz;
+  float duration_ms;
+  float volume;
+} ChirpPatch;
+
+// Oscillator state in device frames. PolyBLEP corrections at both edges
+// keep the square band-limited, so high clicks don't alias on 44.1 kHz.
+typedef struct {
+  float phase;       // Cycles, [0, 1)
+  float increment;   // Cycles per frame
+  float sweep;       // Change of `increment` per frame
+  float envelope;    // Decay term, scaled by `decay` every frame
+  float decay;       // exp(-CHIRP_DECAY_RATE / frames)
+  float attack_step; // 1 / attack frames
+  float amplitude;   // Patch volume
+  uint32_t frame;
+  uint32_t frames;
+} ChirpState;
+
+typedef struct {
+  const SoundBuffer *buffer; // WAV override; nullptr plays the synth
+  uint64_t position;         // 32.32 fixed-point source frame
+  uint64_t step;             // Source frames per device frame, 32.32
+  ChirpState chirp;
+  float gain;
+  float pan_left; // Constant-power pair from pan_table
+  float pan_right;
+  uint8_t slot;
+  bool active;
+} Voice;
+
+static constexpr int VOICE_DEFAULT_COUNT = 16;
+static constexpr int VOICE_MAX_COUNT = 256;
+static constexpr float VOICE_GAIN_MAX = 2.0f;
+static constexpr float MERGE_GAIN_SCALE = 0.1f; // Per merged event
+static constexpr size_t TRIGGER_QUEUE_CAPACITY = 64; // Per client, power of 2
+static constexpr int TRIGGER_QUANTUM = 4; // Triggers per client per period
+// Rings, the library host and replay open sessions beyond the pooled ones;
+// past these, sessions share queue 0
+static constexpr int SPARE_TRIGGER_QUEUES = 9;
+static constexpr int MAX_TRIGGER_QUEUES =
+    MAX_POOL_CLIENTS + SPARE_TRIGGER_QUEUES;
+static constexpr int READY_WORDS = (MAX_TRIGGER_QUEUES + 63) / 64;
+static constexpr size_t PENDING_SUBMITS_MAX = 256;
+static constexpr float CHIRP_ATTACK_MS = 2.0f;
+static constexpr float CHIRP_DECAY_RATE = 10.0f;    // Nepers per sound
+static constexpr float CHIRP_MAX_INCREMENT = 0.25f; // Keeps edges apart
+static constexpr float PAN_QUARTER_TURN = 1.57079632679489661923f;
+static constexpr double AUDIO_DEFAULT_PERIOD_MS = 3.0;
+static constexpr double AUDIO_MIN_PERIOD_MS = 1.0;
+static constexpr double AUDIO_MAX_PERIOD_MS = 50.0;
+static constexpr uint32_t AUDIO_DEFAULT_PARK_S = 60;
+static constexpr uint32_t AUDIO_MAX_PARK_S = 24 * 60 * 60;
+static constexpr int64_t AUDIO_WAKE_STALE_MS = 150; // Later than this: drop
+static constexpr size_t PREWARM_STRIDE = 4096;      // One touch per page
+
+typedef enum {
+  ENGINE_IDLE,
+  ENGINE_STARTING,
+  ENGINE_RUNNING,
+} EngineState;
+
+AudioConfig audio_config = {
+    .exclusive = false,
+    .period_ms = AUDIO_DEFAULT_PERIOD_MS,
+    .park_after_ms = AUDIO_DEFAULT_PARK_S * 1000,
+};
+PoolConfig pool_config = {
+    .voices = VOICE_DEFAULT_COUNT,
+    .clients = PIPE_POOL_SIZE,
+};
+SchedulingConfig scheduling_config = {
+    .mmcss = true,
+    .allow_ecoqos = false,
+    .affinity = 0,
+};
+static atomic_int audio_engine_state = ENGINE_IDLE;
+
+// One per open session, so a client replaying a macro fills its own queue
+// and not anyone else's. Producers are transport threads (one at a time
+// per session, several on the shared queue 0); the consumer is the render
+// thread, which serves the queues by deficit round robin.
+DEFINE_MPSC_RING(TriggerRing, VoiceTrigger, TRIGGER_QUEUE_CAPACITY)
+
+typedef struct {
+  TriggerRing ring;
+  atomic_uint folded[SOUND_SLOT_COUNT]; // Events pushed while ring was full
+  atomic_bool claimed;                  // Held by one session until closed
+  int deficit;                          // Render thread only
+} TriggerQueue;
+
+static TriggerQueue *trigger_queues = nullptr; // Engine arena
+static int trigger_queue_count = 0;
+// Set by producers after a push, collected by the render thread
+static atomic_uint_fast64_t ready_queues[READY_WORDS];
+static uint64_t backlog_queues[READY_WORDS]; // Render thread only
+
+// Set by a render thread that released its stream; the producer that
+// clears it wakes the thread and leaves its event's read time behind.
+static atomic_bool audio_parked = false;
+static _Atomic int64_t wake_read_ticks = 0;
+
+static Voice *voices = nullptr; // Render thread only; pool_config.voices
+// Left/right gains per ClackEvent pan, built before the render thread starts
+static float pan_table[PAN_POSITIONS + 1][MIX_CHANNELS];
+static float pan_width = 1.0f; // --pan-width; 0 keeps every click centred
+static int64_t last_audible_ticks = 0; // Render thread only
+static int64_t stale_before_ticks = 0; // Render thread only; 0 after a drain
+static uint32_t pitch_seed = 0x9E3779B9u; // Render thread only
+
+// The palette cook_sounds.py used to bake into WAVs
+static const ChirpPatch CHIRP_PALETTE[SOUND_SLOT_COUNT] = {
+    [SOUND_SLOT_CLICK] = {1200.0f, 800.0f, 25.0f, 0.20f},
+    [SOUND_SLOT_SPACE] = {600.0f, 400.0f, 45.0f, 0.25f},
+    [SOUND_SLOT_ENTER] = {300.0f, 150.0f, 100.0f, 0.30f},
+};
+
+// ============================================================
+// INSTRUMENTATION TYPES (Per-thread histograms + counters)
+// ============================================================
+typedef enum {
+  STAT_EVENTS,          // Decoded events, before rate limiting
+  STAT_BATCHES,         // Reads that produced an EventBatch
+  STAT_VOICES,          // Voices started by the mixer
+  STAT_MERGES,          // Events folded into a playing voice
+  STAT_DROPS,           // Merge target gone
+  STAT_CONNECTS,        // Editor sessions accepted
+  STAT_DISCONNECTS,     // Editor sessions torn down
+  STAT_PROTOCOL_ERRORS, // Sessions dropped for malformed frames
+  STAT_PARKS,           // Audio streams released after --park-after
+  STAT_WAKE_DROPS,      // Triggers too late to play once the stream was back
+  STAT_SHED,            // Clicks a backed-up client queue dropped, oldest first
+  STAT_FOLDS,           // Starts folded into one: client queue was full
+  STAT_DEFERRED,        // Periods a client's queue carried work to the next
+  STAT_COUNTER_COUNT
+} StatCounter;
+
+typedef enum {
+  LATENCY_DECODE, // Transport read completion -> batch dispatched
+  LATENCY_SUBMIT, // Transport read completion -> buffer handed to the device
+  LATENCY_WAKE,   // Read of the event that woke a parked stream -> reopened
+  LATENCY_STAGE_COUNT
+} LatencyStage;
+
+// Log-linear microsecond buckets: exact below 8 us, then four per octave.
+// 64 buckets reach ~130 ms; anything slower lands in the last one.
+static constexpr int LATENCY_LINEAR_BUCKETS = 8;
+static constexpr int LATENCY_SUB_BUCKET_BITS = 2;
+static constexpr int LATENCY_BUCKETS = 64;
+
+typedef struct {
+  atomic_uint_fast64_t buckets[LATENCY_BUCKETS];
+  atomic_uint_fast64_t max_us;
+} LatencyHistogram;
+
+// Each thread owns one of these and is its only writer, so updates are plain
+// relaxed load/store pairs; the stats server sums them without locking.
+typedef struct {
+  alignas(64) atomic_uint_fast64_t counters[STAT_COUNTER_COUNT];
+  LatencyHistogram latency[LATENCY_STAGE_COUNT];
+} ThreadStats;
+
+// Transport workers plus the render, effects and OS callback threads
+static constexpr int MAX_STAT_THREADS = MAX_PIPE_WORKERS + 8;
+
+// Read timestamps of the triggers applied since the last submitted buffer,
+// so the render thread can time them once the device has the samples.
+typedef struct {
+  int64_t read_ticks[PENDING_SUBMITS_MAX];
+  size_t count;
+} PendingSubmits;
+
+static ThreadStats thread_stats[MAX_STAT_THREADS];
+static atomic_int thread_stats_used = 0;
+static thread_local ThreadStats *local_stats = nullptr;
+static int64_t daemon_start_ticks = 0;
+static PendingSubmits pending_submits; // Render thread only
+
+static const char *const STAT_COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+    [STAT_EVENTS] = "events",
+    [STAT_BATCHES] = "batches",
+    [STAT_VOICES] = "voices",
+    [STAT_MERGES] = "merges",
+    [STAT_DROPS] = "drops",
+    [STAT_CONNECTS] = "connects",
+    [STAT_DISCONNECTS] = "disconnects",
+    [STAT_PROTOCOL_ERRORS] = "protocol_errors",
+    [STAT_PARKS] = "parks",
+    [STAT_WAKE_DROPS] = "wake_drops",
+    [STAT_SHED] = "shed",
+    [STAT_FOLDS] = "folded",
+    [STAT_DEFERRED] = "deferred",
+};
+
+static const char *const LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT] = {
+    [LATENCY_DECODE] = "decode",
+    [LATENCY_SUBMIT] = "submit",
+    [LATENCY_WAKE] = "wake",
+};
+
+// ============================================================
+// TRACE TYPES (--record / --replay)
+// ============================================================
+// A trace is a 16-byte header, then one 12-byte record per decoded event:
+//   Header : 'N' 'C' 'T' 'R' | version u8 | 3 reserved | ticks/s u64 LE
+//   Record : ticks u64 LE | code u8 | intensity u8 | pan u8 | client u8
+// Ticks are the read timestamp on the daemon's clock (QPC on Windows),
+// counted from the start of the recording. Events of one read share their
+// ticks and client, which is how a replay puts them back into one batch
+// on that client's own session. Older traces, with zero in the client
+// byte, replay as a single client.
+static const uint8_t TRACE_MAGIC[4] = {'N', 'C', 'T', 'R'};
+static constexpr uint8_t TRACE_VERSION = 1;
+static constexpr uint32_t TRACE_HEADER_BYTES = 16;
+static constexpr uint32_t TRACE_RECORD_BYTES = 12;
+static constexpr size_t TRACE_QUEUE_CAPACITY = 16384; // Power of two
+static constexpr uint32_t TRACE_WRITE_RECORDS = 4096; // Records per fwrite
+static constexpr uint32_t TRACE_IDLE_MS = 5;
+static constexpr uint32_t TRACE_MAX_FILE_BYTES = 256u * 1024u * 1024u;
+static constexpr int TRACE_CLIENT_COUNT = 256; // Every value of the byte
+
+typedef struct {
+  int64_t ticks;
+  uint8_t code;
+  uint8_t intensity;
+  uint8_t pan;
+  uint8_t client; // ClientSession.trace_id
+} TraceRecord;
+
+// Producers are transport threads, the single consumer is the writer
+// thread. A full ring loses the record, never the sound.
+DEFINE_MPSC_RING(TraceRing, TraceRecord, TRACE_QUEUE_CAPACITY)
+static TraceRing trace_queue;
+static FILE *trace_file = nullptr;   // Writer thread only once recording
+static bool trace_recording = false; // Set once before the transport starts
+static int64_t trace_start_ticks = 0;
+static atomic_uint_fast64_t trace_dropped = 0;
+static atomic_uint trace_next_id = 0; // Handed out by SessionOpen
+
+// ============================================================
+// INTENSITY BUS TYPES (Coalesced activity for visual effects)
+// ============================================================
+// One cache line of shared memory that effect renderers poll at their own
+// frame rate. Transports only count; the publisher thread folds the counts
+// into two exponentially decaying signals, at most once per BUS_FRAME_MS
+// and only when something arrived. Readers decay a sample themselves:
+//   value * exp(-(now - stamp_ticks) * 1000 / ticks_per_second / tau_ms)
+// `sequence` is odd while a sample is written; re-read until it is even
+// and unchanged. Bump BUS_VERSION whenever the layout changes.
+static constexpr uint32_t BUS_MAGIC = 0x5342434E; // "NCBS"
+static constexpr uint32_t BUS_VERSION = 1;
+static constexpr uint32_t BUS_FRAME_MS = 16;    // At most one sample a frame
+static constexpr uint32_t BUS_IDLE_MS = 100;    // Poll interval once quiet
+static constexpr uint32_t BUS_LINGER_MS = 2000; // Quiet this long is idle
+static constexpr float BUS_RATE_TAU_MS = 1000.0f;
+static constexpr float BUS_BURST_TAU_MS = 400.0f;
+static constexpr uint8_t BUS_BURST_EFFECTS =
+    EFFECT_SHAKE | EFFECT_FLASH | EFFECT_PULSE;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  _Atomic(uint32_t) sequence;
+  uint32_t events;          // Every event published so far, wrapping
+  int64_t stamp_ticks;      // Daemon clock: QPC, or CLOCK_MONOTONIC ns
+  int64_t ticks_per_second;
+  float rate;               // Events per second as of stamp_ticks
+  float burst;              // 0 to 1; a shake, flash or pulse sets it to 1
+  float rate_tau_ms;
+  float burst_tau_ms;
+  uint8_t reserved[16];
+} IntensityBus;
+
+static_assert(sizeof(IntensityBus) == 64);
 
-static constexpr int SHAKE_ITERATIONS = 6;
-static constexpr int SHAKE_AMPLITUDE_PX = 15;
-static constexpr DWORD SHAKE_DELAY_MS = 20;
+static IntensityBus *intensity_bus = nullptr; // Set before the publisher runs
+static bool bus_enabled = true;               // --no-bus
+static atomic_uint bus_events = 0; // Counted by transports since the sample
+static atomic_uint bus_bursts = 0;
+
+// ============================================================
+// CLOCK
+// ============================================================
+[[nodiscard]]
+static int64_t NowTicks(void) {
+  return PlatformNowTicks();
+}
 
 // ============================================================
-// WINDOW SEARCH TYPES
+// ENGINE ARENA (Startup-sized pools, sealed before serving)
 // ============================================================
+// The voice pool, the trigger queues and the backend's session pool come
+// out of one block, sized from pool_config and zeroed (so committed) up
+// front. Once sealed it refuses every request, and nothing that runs per
+// event or per audio period touches the heap: latency stays deterministic
+// and the working set stays flat however long the daemon runs.
 typedef struct {
-  DWORD target_pid;
-  HWND best_hwnd;
-  long max_area;
-} WindowSearchParams;
+  uint8_t *base;
+  size_t capacity;
+  size_t used;
+  bool sealed;
+} Arena;
+
+static constexpr size_t ARENA_ALIGNMENT = 64; // Pools never share a line
+
+static Arena engine_arena; // Startup thread only
+
+[[nodiscard]]
+static size_t AlignArena(size_t bytes) {
+  return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+void *ArenaAlloc(size_t bytes) {
+  const size_t size = AlignArena(bytes);
+  if (engine_arena.sealed || engine_arena.capacity - engine_arena.used < size) {
+#if defined(CLICKER_TRAP_HEAP)
+    __builtin_trap(); // A pool size the sizing below doesn't know about
+#endif
+    DaemonLog("Engine arena refused %zu bytes (%s)\n", bytes,
+              engine_arena.sealed ? "sealed" : "exhausted");
+    return nullptr;
+  }
+  void *block = engine_arena.base + engine_arena.used;
+  engine_arena.used += size;
+  return block;
+}
+
+void ArenaSeal(void) {
+  engine_arena.sealed = true;
+}
+
+// `clients` is how many sessions the backend will pool (0 in library
+// mode, where the host is the only client)
+[[nodiscard]]
+static bool StartEngineArena(int clients) {
+  if (engine_arena.base != nullptr)
+    return true;
+  const int queues = clients + SPARE_TRIGGER_QUEUES;
+  const size_t capacity =
+      AlignArena(sizeof(Voice) * (size_t)pool_config.voices) +
+      AlignArena(sizeof(TriggerQueue) * (size_t)queues) +
+      AlignArena(platform_session_bytes * (size_t)clients);
+  // malloc only promises max_align_t; the slack lets the base realign
+  uint8_t *block = malloc(capacity + ARENA_ALIGNMENT);
+  if (block == nullptr) {
+    DaemonLog("Could not reserve %zu bytes for the engine pools\n", capacity);
+    return false;
+  }
+  memset(block, 0, capacity + ARENA_ALIGNMENT); // Fault every page in now
+  const size_t skew = (uintptr_t)block % ARENA_ALIGNMENT;
+  engine_arena = (Arena){
+      .base = block + (skew == 0 ? 0 : ARENA_ALIGNMENT - skew),
+      .capacity = capacity,
+  };
+  voices = ArenaAlloc(sizeof(Voice) * (size_t)pool_config.voices);
+  trigger_queues = ArenaAlloc(sizeof(TriggerQueue) * (size_t)queues);
+  if (voices == nullptr || trigger_queues == nullptr)
+    return false;
+  for (int i = 0; i < queues; i++) {
+    TriggerRingInit(&trigger_queues[i].ring);
+  }
+  trigger_queue_count = queues;
+  return true;
+}
+
+// ============================================================
+// HEAP TRAP (CLICKER_TRAP_HEAP debug builds)
+// ============================================================
+// Decode, dispatch and each audio period run "on the hot path". A trap
+// build's allocator hook (in the backend) aborts on any allocation made
+// there; one-time starts that run inside it step out explicitly.
+#if defined(CLICKER_TRAP_HEAP)
+static thread_local int hot_path_depth = 0;
+#endif
+
+static void EnterHotPath(void) {
+#if defined(CLICKER_TRAP_HEAP)
+  hot_path_depth++;
+#endif
+}
+
+static void LeaveHotPath(void) {
+#if defined(CLICKER_TRAP_HEAP)
+  hot_path_depth--;
+#endif
+}
+
+bool OnHotPath(void) {
+#if defined(CLICKER_TRAP_HEAP)
+  return hot_path_depth > 0;
+#else
+  return false;
+#endif
+}
+
+int PauseHotPath(void) {
+#if defined(CLICKER_TRAP_HEAP)
+  const int depth = hot_path_depth;
+  hot_path_depth = 0;
+  return depth;
+#else
+  return 0;
+#endif
+}
 
-static constexpr int MIN_WINDOW_DIMENSION = 100;
+void ResumeHotPath([[maybe_unused]] int depth) {
+#if defined(CLICKER_TRAP_HEAP)
+  hot_path_depth = depth;
+#endif
+}
 
 // ============================================================
-// WINDOW ENUMERATION CALLBACK
+// INSTRUMENTATION (Lock-free stats + nvim_clack_stats endpoint)
 // ============================================================
-static BOOL CALLBACK FindTerminalWindowProc(HWND hwnd, LPARAM l_param) {
-  WindowSearchParams *params = (WindowSearchParams *)(void *)l_param;
+[[nodiscard]]
+static ThreadStats *LocalStats(void) {
+  if (local_stats == nullptr) {
+    int index = atomic_fetch_add(&thread_stats_used, 1);
+    if (index >= MAX_STAT_THREADS) {
+      // Out of slots: share the last one and accept the odd lost increment
+      index = MAX_STAT_THREADS - 1;
+    }
+    local_stats = &thread_stats[index];
+  }
+  return local_stats;
+}
+
+static void BumpStat(atomic_uint_fast64_t *value, uint64_t amount) {
+  const uint64_t current = atomic_load_explicit(value, memory_order_relaxed);
+  atomic_store_explicit(value, current + amount, memory_order_relaxed);
+}
+
+static void CountStat(StatCounter counter, uint64_t amount) {
+  BumpStat(&LocalStats()->counters[counter], amount);
+}
+
+// Split so the multiply can't overflow: a 1 GHz clock would wrap
+// ticks * 1e6 after about five hours of uptime
+[[nodiscard]]
+static uint64_t TicksToMicros(int64_t ticks) {
+  if (ticks <= 0)
+    return 0;
+  const uint64_t rate = (uint64_t)clock_ticks_per_second;
+  return ((uint64_t)ticks / rate * 1000000u) +
+         ((uint64_t)ticks % rate * 1000000u / rate);
+}
 
-  DWORD window_pid = 0;
-  GetWindowThreadProcessId(hwnd, &window_pid);
+[[nodiscard]]
+static int LatencyBucket(uint64_t us) {
+  if (us < (uint64_t)LATENCY_LINEAR_BUCKETS)
+    return (int)us;
+
+  const int octave = 63 - __builtin_clzll(us);
+  const int sub = (int)(us >> (octave - LATENCY_SUB_BUCKET_BITS)) &
+                  ((1 << LATENCY_SUB_BUCKET_BITS) - 1);
+  const int index = LATENCY_LINEAR_BUCKETS +
+                    ((octave - 3) << LATENCY_SUB_BUCKET_BITS) + sub;
+  return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+// Upper edge of a bucket, so reported percentiles never flatter us
+[[nodiscard]]
+static uint64_t LatencyBucketLimit(int index) {
+  if (index < LATENCY_LINEAR_BUCKETS)
+    return (uint64_t)index;
+
+  const int octave = ((index - LATENCY_LINEAR_BUCKETS) >>
+                      LATENCY_SUB_BUCKET_BITS) + 3;
+  const uint64_t sub =
+      (uint64_t)(index - LATENCY_LINEAR_BUCKETS) &
+      ((1u << LATENCY_SUB_BUCKET_BITS) - 1);
+  const uint64_t base = (uint64_t)1 << LATENCY_SUB_BUCKET_BITS;
+  return ((base + sub + 1) << (octave - LATENCY_SUB_BUCKET_BITS)) - 1;
+}
+
+static void RecordLatency(LatencyStage stage, int64_t since_ticks) {
+  LatencyHistogram *histogram = &LocalStats()->latency[stage];
+  const uint64_t us = TicksToMicros(NowTicks() - since_ticks);
+  BumpStat(&histogram->buckets[LatencyBucket(us)], 1);
+  if (us > atomic_load_explicit(&histogram->max_us, memory_order_relaxed)) {
+    atomic_store_explicit(&histogram->max_us, us, memory_order_relaxed);
+  }
+}
+
+[[nodiscard]]
+static uint64_t HistogramPercentile(const uint64_t *buckets, uint64_t total,
+                                    uint64_t max_us, double fraction) {
+  const uint64_t rank = (uint64_t)ceil((double)total * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS && total > 0; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      const uint64_t limit = LatencyBucketLimit(i);
+      return limit < max_us ? limit : max_us;
+    }
+  }
+  return max_us;
+}
 
-  // Filter by PID and Visibility
-  if (window_pid == params->target_pid && IsWindowVisible(hwnd) != FALSE) {
-    RECT rect;
-    if (GetWindowRect(hwnd, &rect) != FALSE) {
-      long width = rect.right - rect.left;
-      long height = rect.bottom - rect.top;
-      long area = width * height;
+// Folds every thread's slot into one JSON object. Readers may race writers
+// by an event or two, which is fine for a dashboard.
+int FormatStatsJson(char *out, size_t capacity) {
+  uint64_t counters[STAT_COUNTER_COUNT] = {0};
+  uint64_t buckets[LATENCY_STAGE_COUNT][LATENCY_BUCKETS] = {0};
+  uint64_t totals[LATENCY_STAGE_COUNT] = {0};
+  uint64_t max_us[LATENCY_STAGE_COUNT] = {0};
 
-      // The actual terminal frame is always the largest visible window
-      // belonging to the process. We ignore tiny utility windows.
-      if (area > params->max_area && width > MIN_WINDOW_DIMENSION) {
-        params->max_area = area;
-        params->best_hwnd = hwnd;
+  int used = atomic_load(&thread_stats_used);
+  if (used > MAX_STAT_THREADS) {
+    used = MAX_STAT_THREADS;
+  }
+  for (int t = 0; t < used; t++) {
+    const ThreadStats *stats = &thread_stats[t];
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+      counters[c] +=
+          atomic_load_explicit(&stats->counters[c], memory_order_relaxed);
+    }
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+      const LatencyHistogram *histogram = &stats->latency[s];
+      for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        const uint64_t hits =
+            atomic_load_explicit(&histogram->buckets[b], memory_order_relaxed);
+        buckets[s][b] += hits;
+        totals[s] += hits;
+      }
+      const uint64_t peak =
+          atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+      if (peak > max_us[s]) {
+        max_us[s] = peak;
       }
     }
   }
-  return TRUE; // Continue searching all windows
+
+  const uint64_t uptime_ms =
+      TicksToMicros(NowTicks() - daemon_start_ticks) / 1000u;
+  int length = snprintf(out, capacity, "{\"uptime_ms\":%llu",
+                        (unsigned long long)uptime_ms);
+  for (int c = 0; c < STAT_COUNTER_COUNT && length < (int)capacity; c++) {
+    length += snprintf(out + length, capacity - length, ",\"%s\":%llu",
+                       STAT_COUNTER_NAMES[c], (unsigned long long)counters[c]);
+  }
+  // Raw buckets too, so a benchmark can diff two snapshots of one run
+  for (int s = 0; s < LATENCY_STAGE_COUNT && length < (int)capacity; s++) {
+    length += snprintf(
+        out + length, capacity - length,
+        ",\"%s\":{\"count\":%llu,\"p50_us\":%llu,\"p99_us\":%llu,"
+        "\"max_us\":%llu,\"buckets\":[",
+        LATENCY_STAGE_NAMES[s], (unsigned long long)totals[s],
+        (unsigned long long)HistogramPercentile(buckets[s], totals[s],
+                                                max_us[s], 0.50),
+        (unsigned long long)HistogramPercentile(buckets[s], totals[s],
+                                                max_us[s], 0.99),
+        (unsigned long long)max_us[s]);
+    for (int b = 0; b < LATENCY_BUCKETS && length < (int)capacity; b++) {
+      length += snprintf(out + length, capacity - length, "%s%llu",
+                         b == 0 ? "" : ",", (unsigned long long)buckets[s][b]);
+    }
+    if (length < (int)capacity) {
+      length += snprintf(out + length, capacity - length, "]}");
+    }
+  }
+  if (length < (int)capacity) {
+    length += snprintf(out + length, capacity - length, "}\n");
+  }
+  return length < (int)capacity ? length : (int)capacity - 1;
 }
 
 // ============================================================
-// WINDOW MANIPULATION (The Earthquake)
+// LOGGING
 // ============================================================
-static void ShakeWindowsTerminal(void) {
-  HWND active_hwnd = GetForegroundWindow();
-  if (active_hwnd == nullptr)
+// Detached launches (jobstart with detach = true) have no usable stdout, so
+// formatting a message there is wasted work on the editor's startup path.
+void DaemonLog(const char *format, ...) {
+  if (!log_enabled)
     return;
 
-  DWORD current_pid = 0;
-  GetWindowThreadProcessId(active_hwnd, &current_pid);
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+}
 
-  // Search for the largest window owned by the foreground process
-  WindowSearchParams params = {
-      .target_pid = current_pid, .best_hwnd = nullptr, .max_area = 0};
-  EnumWindows(FindTerminalWindowProc, (LPARAM)(void *)&params);
+// ============================================================
+// EVENT MAP (clack_events.conf -> the dispatch table)
+// ============================================================
+// One event code per line; '#' starts a comment:
+//   <code> <sound> [gain] [jitter] [effect ...]
+//   code    one character, 0xNN, or "default" for every unlisted byte
+//   sound   click, space, enter, or none for effects only
+//   gain    scales the event's intensity, 0 to 1.99 (default 1)
+//   jitter  pitch spread of synthesized voices, +/- percent (default 4)
+//   effect  shake, flash, pulse (intensity bus burst only)
+// A map file replaces the built-in table entirely. Bad lines are logged
+// and skipped; deleting the file brings the built-in table back.
+static constexpr uint32_t EVENT_MAP_MAX_BYTES = 64u * 1024u;
+static constexpr size_t EVENT_MAP_LINE_MAX = 256;
+static constexpr double EVENT_GAIN_MAX = 255.0 / EVENT_GAIN_UNITY;
+static constexpr double EVENT_JITTER_MAX = 50.0;
 
-  if (params.best_hwnd == nullptr)
-    return;
+static const char *const LANE_NAMES[EVENT_LANE_COUNT] = {
+    [SOUND_SLOT_CLICK] = "click",
+    [SOUND_SLOT_SPACE] = "space",
+    [SOUND_SLOT_ENTER] = "enter",
+    [LANE_SILENT] = "none",
+};
 
-  RECT rect;
-  if (GetWindowRect(params.best_hwnd, &rect) != FALSE &&
-      IsZoomed(params.best_hwnd) == FALSE) {
-    for (int i = 0; i < SHAKE_ITERATIONS; i++) {
-      const int offset_x =
-          (i % 2 == 0) ? SHAKE_AMPLITUDE_PX : -SHAKE_AMPLITUDE_PX;
+// Cuts the next blank-separated token out of the line. Returns nullptr at
+// the end of the line or where a comment starts.
+[[nodiscard]]
+static char *NextToken(char **cursor) {
+  char *at = *cursor;
+  while (*at == ' ' || *at == '\t') {
+    at++;
+  }
+  if (*at == '\0' || *at == '#')
+    return nullptr;
 
-      // SWP_NOSIZE | SWP_NOZORDER ensures we only change the X/Y position
-      SetWindowPos(params.best_hwnd, nullptr, rect.left + offset_x, rect.top, 0,
-                   0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
-      Sleep(SHAKE_DELAY_MS);
-    }
+  char *token = at;
+  while (*at != '\0' && *at != ' ' && *at != '\t') {
+    at++;
+  }
+  if (*at != '\0') {
+    *at++ = '\0';
+  }
+  *cursor = at;
+  return token;
+}
 
-    // Final snap back to the exact original coordinates
-    SetWindowPos(params.best_hwnd, nullptr, rect.left, rect.top, 0, 0,
-                 SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+// `code` is the byte, or -1 for "default"
+[[nodiscard]]
+static bool ParseEventCode(const char *token, int *code) {
+  if (strcmp(token, "default") == 0) {
+    *code = -1;
+    return true;
+  }
+  if (token[1] == '\0') {
+    *code = (uint8_t)token[0];
+    return true;
   }
+  if (strncmp(token, "0x", 2) != 0)
+    return false;
+  char *end = nullptr;
+  const unsigned long value = strtoul(token + 2, &end, 16);
+  if (end == token + 2 || *end != '\0' || value > 0xFF)
+    return false;
+  *code = (int)value;
+  return true;
 }
 
-static DWORD WINAPI ShakeThread([[maybe_unused]] LPVOID parameter) {
-  ShakeWindowsTerminal();
-  atomic_store(&is_shaking, false);
-  return 0;
+// Returns what was wrong with the rest of the line, or nullptr once
+// `action` holds it
+[[nodiscard]]
+static const char *ParseEventAction(char **cursor, EventAction *action) {
+  const char *sound = NextToken(cursor);
+  if (sound == nullptr)
+    return "missing sound";
+  int lane = 0;
+  while (lane < EVENT_LANE_COUNT && strcmp(sound, LANE_NAMES[lane]) != 0) {
+    lane++;
+  }
+  if (lane == EVENT_LANE_COUNT)
+    return "unknown sound";
+  *action = DEFAULT_EVENT_ACTION;
+  action->lane = (uint8_t)lane;
+
+  int numbers = 0; // Gain first, then jitter
+  for (char *token = NextToken(cursor); token != nullptr;
+       token = NextToken(cursor)) {
+    if (strcmp(token, "shake") == 0) {
+      action->effects |= EFFECT_SHAKE;
+      continue;
+    }
+    if (strcmp(token, "flash") == 0) {
+      action->effects |= EFFECT_FLASH;
+      continue;
+    }
+    if (strcmp(token, "pulse") == 0) {
+      action->effects |= EFFECT_PULSE;
+      continue;
+    }
+    char *end = nullptr;
+    const double value = strtod(token, &end);
+    if (end == token || *end != '\0' || numbers == 2)
+      return "unknown field";
+    if (numbers++ == 0) {
+      if (!(value >= 0.0 && value <= EVENT_GAIN_MAX))
+        return "gain out of range";
+      action->gain = (uint8_t)lround(value * EVENT_GAIN_UNITY);
+    } else {
+      if (!(value >= 0.0 && value <= EVENT_JITTER_MAX))
+        return "jitter out of range";
+      action->jitter = (uint8_t)lround(value);
+    }
+  }
+  return nullptr;
+}
+
+static void BuildBuiltinEventTable(EventTable *table) {
+  for (int code = 0; code < 256; code++) {
+    table->actions[code] = DEFAULT_EVENT_ACTION;
+  }
+  for (size_t i = 0; i < sizeof(BUILTIN_EVENT_ACTIONS) /
+                             sizeof(BUILTIN_EVENT_ACTIONS[0]);
+       i++) {
+    table->actions[BUILTIN_EVENT_ACTIONS[i].code] =
+        BUILTIN_EVENT_ACTIONS[i].action;
+  }
 }
 
-static void TriggerShakeBackground(void) {
-  // Atomic check-and-set to prevent overlapping shakes
-  if (!atomic_exchange(&is_shaking, true)) {
-    HANDLE thread_handle =
-        CreateThread(nullptr, 0, ShakeThread, nullptr, 0, nullptr);
+static void BuildEventTable(const char *text, uint32_t size,
+                            EventTable *table) {
+  bool listed[256] = {0};
+  EventAction fallback = DEFAULT_EVENT_ACTION;
+  char line[EVENT_MAP_LINE_MAX];
+  uint32_t offset = 0;
+  int line_number = 0;
+
+  while (offset < size) {
+    uint32_t length = 0;
+    while (offset + length < size && text[offset + length] != '\n') {
+      length++;
+    }
+    const uint32_t line_start = offset;
+    offset += length + 1;
+    line_number++;
+    if (length >= sizeof(line)) {
+      DaemonLog("%s:%d: line too long\n", event_map_path, line_number);
+      continue;
+    }
+    memcpy(line, text + line_start, length);
+    line[length] = '\0';
+    if (length > 0 && line[length - 1] == '\r') {
+      line[length - 1] = '\0';
+    }
+
+    char *cursor = line;
+    const char *code_token = NextToken(&cursor);
+    if (code_token == nullptr)
+      continue; // Blank or comment
 
-    if (thread_handle != nullptr) {
-      CloseHandle(thread_handle); // Detach thread
+    int code = 0;
+    EventAction action;
+    const char *error = ParseEventCode(code_token, &code)
+                            ? ParseEventAction(&cursor, &action)
+                            : "unknown event code";
+    if (error != nullptr) {
+      DaemonLog("%s:%d: %s; line skipped\n", event_map_path, line_number,
+                error);
+    } else if (code < 0) {
+      fallback = action;
     } else {
-      atomic_store(&is_shaking, false); // Fallback unlock
+      table->actions[code] = action;
+      listed[code] = true;
+    }
+  }
+
+  for (int code = 0; code < 256; code++) {
+    if (!listed[code]) {
+      table->actions[code] = fallback;
+    }
+  }
+}
+
+// Rebuilds the spare table and publishes it. Forced once at startup before
+// any client exists; after that ReloadSoundBank follows the file's stamp.
+static void ReloadEventMap(bool force) {
+  uint64_t stamp = 0;
+  if (!PlatformFileStamp(event_map_path, &stamp)) {
+    stamp = 0; // No map file: the built-in table
+  }
+  if (!force && stamp == event_map_stamp)
+    return;
+
+  EventTable *table = &event_tables[event_table_spare];
+  if (stamp == 0) {
+    BuildBuiltinEventTable(table);
+    if (event_map_stamp != 0) {
+      DaemonLog("%s is gone; back to the built-in event map\n",
+                event_map_path);
+    }
+  } else {
+    uint32_t size = 0;
+    uint8_t *text =
+        PlatformReadFile(event_map_path, EVENT_MAP_MAX_BYTES, &size);
+    if (text == nullptr) {
+      DaemonLog("Could not read %s; keeping the current event map\n",
+                event_map_path);
+      return;
     }
+    BuildEventTable((const char *)text, size, table);
+    free(text);
+    DaemonLog("Loaded %s\n", event_map_path);
   }
+  event_map_stamp = stamp;
+  atomic_store_explicit(&event_table, table, memory_order_release);
+  event_table_spare ^= 1;
 }
 
 // ============================================================
-// LOGIC HELPERS (Complexity Reduction)
+// SOUND BANK LOADING & HOT RELOAD
 // ============================================================
+[[nodiscard]]
+static uint32_t ReadLE32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+[[nodiscard]]
+static uint16_t ReadLE16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+[[nodiscard]]
+static uint64_t ReadLE64(const uint8_t *p) {
+  return (uint64_t)ReadLE32(p) | ((uint64_t)ReadLE32(p + 4) << 32);
+}
+
+// Walks the RIFF chunk list once so the hot path never sees a bad image.
+// We only accept plain PCM with a non-empty data chunk inside the file.
+[[nodiscard]]
+static bool ParseWavImage(const uint8_t *data, uint32_t size, WavInfo *info) {
+  if (size < RIFF_HEADER_BYTES || memcmp(data, "RIFF", 4) != 0 ||
+      memcmp(data + 8, "WAVE", 4) != 0)
+    return false;
+
+  bool has_fmt = false;
+  bool has_data = false;
+  uint32_t offset = RIFF_HEADER_BYTES;
+
+  while (offset + CHUNK_HEADER_BYTES <= size) {
+    const uint8_t *chunk = data + offset;
+    const uint32_t chunk_size = ReadLE32(chunk + 4);
+    const uint32_t body = offset + CHUNK_HEADER_BYTES;
+
+    if (chunk_size > size - body)
+      return false; // Truncated file (e.g. still being written)
 
-// 1. Encapsulate Pipe Creation Retry Logic
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunk_size < FMT_CHUNK_MIN_BYTES)
+        return false;
+      const uint16_t format = ReadLE16(data + body);
+      info->channels = ReadLE16(data + body + 2);
+      info->sample_rate = ReadLE32(data + body + 4);
+      info->bits = ReadLE16(data + body + 14);
+      has_fmt = format == WAV_FORMAT_PCM &&
+                (info->channels == 1 || info->channels == 2) &&
+                (info->bits == 8 || info->bits == 16) && info->sample_rate > 0;
+      if (!has_fmt)
+        return false;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      info->samples = data + body;
+      info->sample_bytes = chunk_size;
+      has_data = chunk_size > 0;
+    }
+
+    // Chunks are word-aligned; odd sizes carry one pad byte
+    offset = body + chunk_size + (chunk_size & 1u);
+  }
+  return has_fmt && has_data;
+}
+
+// Converts 8/16-bit PCM (mono or stereo) into the mixer's mono float layout
 [[nodiscard]]
-static HANDLE CreatePipeInstance(void) {
-  HANDLE hPipe = INVALID_HANDLE_VALUE;
-  while (hPipe == INVALID_HANDLE_VALUE) {
-    hPipe = CreateNamedPipeA(PIPE_NAME, PIPE_ACCESS_INBOUND,
-                             PIPE_TYPE_BYTE | PIPE_WAIT, PIPE_MAX_INST,
-                             PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, nullptr);
+static SoundBuffer *DecodeWavImage(const WavInfo *info) {
+  const uint32_t frame_bytes = info->channels * (info->bits / 8u);
+  const uint32_t frames = info->sample_bytes / frame_bytes;
+  if (frames == 0)
+    return nullptr;
+
+  SoundBuffer *buffer =
+      malloc(sizeof(SoundBuffer) + (sizeof(float) * (frames + 1u)));
+  if (buffer == nullptr)
+    return nullptr;
 
-    if (hPipe == INVALID_HANDLE_VALUE) {
-      printf(
-          "Pipe busy or creation failed (Error %lu). Retrying in %lu ms...\n",
-          GetLastError(), RETRY_DELAY_MS);
-      Sleep(RETRY_DELAY_MS);
+  buffer->frames = frames;
+  buffer->sample_rate = info->sample_rate;
+
+  for (uint32_t i = 0; i < frames; i++) {
+    const uint8_t *frame = info->samples + ((size_t)i * frame_bytes);
+    float sum = 0.0f;
+    for (uint16_t c = 0; c < info->channels; c++) {
+      sum += (info->bits == 8)
+                 ? ((float)frame[c] - 128.0f) / 128.0f
+                 : (float)(int16_t)ReadLE16(frame + (c * 2u)) / 32768.0f;
     }
+    buffer->samples[i] = sum / (float)info->channels;
   }
-  return hPipe;
+  buffer->samples[frames] = 0.0f; // Interpolation guard
+  return buffer;
 }
 
-// 2. Encapsulate Sound Selection & Side Effects
+// Reads, validates and decodes a whole WAV file. Returns nullptr on any
+// failure.
 [[nodiscard]]
-static const char *DetermineSoundAndAction(char code) {
-  switch (code) {
-  case 'e':
-    return SOUND_ENTER;
-  case 's':
-    return SOUND_SPACE;
-  case 'x':
-    TriggerShakeBackground();
-    return SOUND_ENTER;
-  default:
-    return SOUND_CLICK;
+static SoundBuffer *LoadWavFile(const char *path) {
+  uint32_t size = 0;
+  uint8_t *image = PlatformReadFile(path, SOUND_MAX_FILE_BYTES, &size);
+  if (image == nullptr)
+    return nullptr;
+
+  SoundBuffer *buffer = nullptr;
+  WavInfo info = {0};
+  if (ParseWavImage(image, size, &info)) {
+    buffer = DecodeWavImage(&info);
   }
+  free(image);
+  return buffer;
 }
 
-// 3. Encapsulate the Read Loop
-static void HandleClientSession(HANDLE hPipe) {
-  char buffer = 0;
-  DWORD bytesRead = 0;
+// Publishes a slot's new buffer only when its file changed AND the new image
+// decodes, so a half-saved WAV never evicts the last good one. The render
+// thread adopts it at its next period.
+static bool ReloadSoundSlot(SoundSlot *slot) {
+  // Whatever the render thread finished with since the last reload
+  free(atomic_exchange(&slot->retired, nullptr));
 
-  while (ReadFile(hPipe, &buffer, READ_BUFFER_SIZE, &bytesRead, nullptr)) {
-    if (bytesRead > 0) {
-      const char *soundPath = DetermineSoundAndAction(buffer);
-      PlaySoundA(soundPath, nullptr, SND_FILENAME | SND_ASYNC | SND_NODEFAULT);
-      buffer = 0; // Clear buffer for next read
+  uint64_t stamp = 0;
+  if (!PlatformFileStamp(slot->path, &stamp) || stamp == slot->stamp)
+    return false;
+
+  SoundBuffer *buffer = LoadWavFile(slot->path);
+  if (buffer == nullptr)
+    return false;
+
+  slot->stamp = stamp;
+  // A previous reload the render thread never picked up is simply superseded
+  free(atomic_exchange(&slot->pending, buffer));
+  return true;
+}
+
+// WAVs are optional overrides; a slot without one plays its synth patch.
+// `force` re-reads files whose timestamp looks unchanged (control "reload").
+void ReloadSoundBank(bool force) {
+  ReloadEventMap(false); // Loaded at startup; any save changes its stamp
+  for (int i = 0; i < SOUND_SLOT_COUNT; i++) {
+    SoundSlot *slot = &sound_bank[i];
+    if (force) {
+      slot->stamp = 0;
+    }
+    if (ReloadSoundSlot(slot)) {
+      DaemonLog("Loaded %s\n", slot->path);
     }
   }
 }
 
 // ============================================================
-// MAIN
+// MIXER (Render thread only)
 // ============================================================
-int main() {
-  printf("Starting Neovim Sound Daemon (C23)...\n");
-  printf("Listening on %s\n", PIPE_NAME);
+[[nodiscard]]
+static bool VoicesReference(const SoundBuffer *buffer) {
+  for (int i = 0; i < pool_config.voices; i++) {
+    if (voices[i].buffer == buffer)
+      return true;
+  }
+  return false;
+}
 
-  HANDLE hPipe = CreatePipeInstance();
+// Swaps freshly reloaded buffers in and hands unreferenced ones back
+static void AdoptPendingSounds(void) {
+  for (int i = 0; i < SOUND_SLOT_COUNT; i++) {
+    SoundSlot *slot = &sound_bank[i];
 
-  while (true) {
-    // Wait for a client connection
-    BOOL connected = ConnectNamedPipe(hPipe, nullptr)
-                         ? TRUE
-                         : (GetLastError() == ERROR_PIPE_CONNECTED);
+    if (slot->draining != nullptr && !VoicesReference(slot->draining)) {
+      SoundBuffer *expected = nullptr;
+      if (atomic_compare_exchange_strong(&slot->retired, &expected,
+                                         slot->draining)) {
+        slot->draining = nullptr;
+      }
+    }
 
-    if (connected) {
-      HandleClientSession(hPipe);
-    } else {
-      // Yield CPU if connection failed but pipe is valid
-      Sleep(IDLE_YIELD_MS);
+    if (slot->draining == nullptr) {
+      SoundBuffer *fresh = atomic_exchange(&slot->pending, nullptr);
+      if (fresh != nullptr) {
+        slot->draining = slot->live;
+        slot->live = fresh;
+      }
+    }
+  }
+}
+
+// How far through its sound a voice is, in 1/256ths
+[[nodiscard]]
+static uint64_t VoiceProgress(const Voice *voice) {
+  if (voice->buffer != nullptr)
+    return (voice->position >> 32) * 256u / voice->buffer->frames;
+  return (uint64_t)voice->chirp.frame * 256u / voice->chirp.frames;
+}
+
+// xorshift32; plenty for detuning clicks
+[[nodiscard]]
+static float PitchJitter(uint8_t percent) {
+  pitch_seed ^= pitch_seed << 13;
+  pitch_seed ^= pitch_seed >> 17;
+  pitch_seed ^= pitch_seed << 5;
+  const float unit = (float)(pitch_seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+  return 1.0f + (unit * (float)percent / 100.0f);
+}
+
+[[nodiscard]]
+static float ClampIncrement(float increment) {
+  return increment > CHIRP_MAX_INCREMENT ? CHIRP_MAX_INCREMENT : increment;
+}
+
+[[nodiscard]]
+static ChirpState MakeChirp(const ChirpPatch *patch, uint32_t device_rate,
+                            float pitch) {
+  const float rate = (float)device_rate;
+  uint32_t frames = (uint32_t)(patch->duration_ms * rate / 1000.0f);
+  uint32_t attack_frames = (uint32_t)(CHIRP_ATTACK_MS * rate / 1000.0f);
+  if (frames == 0) {
+    frames = 1;
+  }
+  if (attack_frames == 0) {
+    attack_frames = 1;
+  }
+
+  const float start = ClampIncrement(patch->start_hz * pitch / rate);
+  const float end = ClampIncrement(patch->end_hz * pitch / rate);
+  return (ChirpState){
+      .phase = 0.0f,
+      .increment = start,
+      .sweep = (end - start) / (float)frames,
+      .envelope = 1.0f,
+      .decay = expf(-CHIRP_DECAY_RATE / (float)frames),
+      .attack_step = 1.0f / (float)attack_frames,
+      .amplitude = patch->volume,
+      .frame = 0,
+      .frames = frames,
+  };
+}
+
+// Overlapping clicks layer instead of cutting each other off. When the pool
+// is full the voice closest to its end is stolen; it is the least audible.
+// A WAV dropped into sounds/ overrides the synthesized patch for its slot.
+static void StartVoice(uint8_t slot, const SoundBuffer *buffer, float gain,
+                       uint8_t jitter, uint8_t pan, uint32_t device_rate) {
+  Voice *target = &voices[0];
+  uint64_t best_progress = 0;
+
+  for (int i = 0; i < pool_config.voices; i++) {
+    Voice *voice = &voices[i];
+    if (!voice->active) {
+      target = voice;
+      break;
     }
+    const uint64_t progress = VoiceProgress(voice);
+    if (progress >= best_progress) {
+      best_progress = progress;
+      target = voice;
+    }
+  }
 
-    // Reset pipe for next client
-    DisconnectNamedPipe(hPipe);
+  *target = (Voice){
+      .buffer = buffer,
+      .gain = gain,
+      .pan_left = pan_table[pan][0],
+      .pan_right = pan_table[pan][1],
+      .slot = slot,
+      .active = true,
+  };
+  if (buffer != nullptr) {
+    target->step = ((uint64_t)buffer->sample_rate << 32) / device_rate;
+  } else {
+    target->chirp =
+        MakeChirp(&CHIRP_PALETTE[slot], device_rate, PitchJitter(jitter));
   }
+}
+
+// Coalesced events make the newest voice of their slot louder rather than
+// stacking more voices. Returns false if that voice has already finished.
+static bool MergeIntoVoice(uint8_t slot, uint32_t count, float level) {
+  Voice *youngest = nullptr;
+  uint64_t youngest_progress = 0;
+  for (int i = 0; i < pool_config.voices; i++) {
+    Voice *voice = &voices[i];
+    if (!voice->active || voice->slot != slot)
+      continue;
 
-  // Compiler knows execution never passes here
-  unreachable();
+    const uint64_t progress = VoiceProgress(voice);
+    if (youngest == nullptr || progress < youngest_progress) {
+      youngest = voice;
+      youngest_progress = progress;
+    }
+  }
+  if (youngest == nullptr)
+    return false;
+
+  const float boosted =
+      youngest->gain + ((float)count * MERGE_GAIN_SCALE * level);
+  youngest->gain = boosted > VOICE_GAIN_MAX ? VOICE_GAIN_MAX : boosted;
+  return true;
+}
+
+[[nodiscard]]
+static float BurstGain(uint32_t count, float peak_level) {
+  const float gain =
+      1.0f + (BURST_GAIN_PER_DOUBLING * log2f((float)count));
+  return (gain > BURST_GAIN_MAX ? BURST_GAIN_MAX : gain) * peak_level;
+}
+
+static void ApplyTrigger(const VoiceTrigger *trigger, uint32_t device_rate,
+                         PendingSubmits *pending) {
+  if (trigger->read_ticks < stale_before_ticks) {
+    CountStat(STAT_WAKE_DROPS, 1);
+    return;
+  }
+  if (trigger->kind == TRIGGER_MERGE) {
+    const bool merged =
+        MergeIntoVoice(trigger->slot, trigger->count, trigger->gain);
+    CountStat(merged ? STAT_MERGES : STAT_DROPS, trigger->count);
+    return;
+  }
+  StartVoice(trigger->slot, sound_bank[trigger->slot].live, trigger->gain,
+             trigger->jitter, trigger->pan, device_rate);
+  CountStat(STAT_VOICES, 1);
+  if (pending->count < PENDING_SUBMITS_MAX) {
+    pending->read_ticks[pending->count++] = trigger->read_ticks;
+  }
+}
+
+// One client's turn: up to TRIGGER_QUANTUM triggers, unspent credit kept
+// while it has more. A backlog longer than the credit sheds its oldest
+// clicks and spaces outright; enters wait, they are never dropped.
+// Returns true when work is left over for the next period.
+[[nodiscard]]
+static bool DrainTriggerQueue(TriggerQueue *queue, uint32_t device_rate,
+                              PendingSubmits *pending) {
+  for (int slot = 0; slot < SOUND_SLOT_COUNT; slot++) {
+    const unsigned folded = atomic_exchange(&queue->folded[slot], 0);
+    if (folded != 0) {
+      StartVoice((uint8_t)slot, sound_bank[slot].live,
+                 BurstGain(folded, 1.0f), EVENT_DEFAULT_JITTER, PAN_NONE,
+                 device_rate);
+      CountStat(STAT_VOICES, 1);
+    }
+  }
+
+  queue->deficit += TRIGGER_QUANTUM;
+  VoiceTrigger trigger;
+  while (queue->deficit > 0 && TriggerRingPop(&queue->ring, &trigger)) {
+    const size_t behind = TriggerRingDepth(&queue->ring);
+    if (LANE_RATE_LIMITED[trigger.slot] && behind >= (size_t)queue->deficit) {
+      CountStat(STAT_SHED, 1); // Newer ones behind it get the credit
+      continue;
+    }
+    ApplyTrigger(&trigger, device_rate, pending);
+    queue->deficit--;
+  }
+  if (!TriggerRingPending(&queue->ring)) {
+    queue->deficit = 0; // An idle client banks nothing
+    return false;
+  }
+  CountStat(STAT_DEFERRED, 1);
+  return true;
+}
+
+// Every queue with work gets its turn in the same period, so one client's
+// flood costs the others nothing but the voices it was already playing.
+static void DrainVoiceTriggers(uint32_t device_rate, PendingSubmits *pending) {
+  for (int word = 0; word < READY_WORDS; word++) {
+    uint64_t work = backlog_queues[word] |
+                    atomic_exchange(&ready_queues[word], 0);
+    uint64_t left = 0;
+    while (work != 0) {
+      const int bit = __builtin_ctzll(work);
+      work &= work - 1;
+      TriggerQueue *queue = &trigger_queues[(word * 64) + bit];
+      if (DrainTriggerQueue(queue, device_rate, pending)) {
+        left |= 1ull << bit;
+      }
+    }
+    backlog_queues[word] = left;
+  }
+  stale_before_ticks = 0;
+}
+
+static void RecordSubmits(PendingSubmits *pending) {
+  for (size_t i = 0; i < pending->count; i++) {
+    RecordLatency(LATENCY_SUBMIT, pending->read_ticks[i]);
+  }
+  pending->count = 0;
+}
+
+// Resamples a WAV override into the mix. Returns false once it has ended.
+[[nodiscard]]
+static bool MixSampleVoice(Voice *voice, float *mix, uint32_t frames) {
+  const SoundBuffer *buffer = voice->buffer;
+  const float left = voice->gain * voice->pan_left;
+  const float right = voice->gain * voice->pan_right;
+  for (uint32_t f = 0; f < frames; f++) {
+    const uint64_t index = voice->position >> 32;
+    if (index >= buffer->frames)
+      return false;
+
+    const float frac =
+        (float)(voice->position & 0xFFFFFFFFu) * (1.0f / 4294967296.0f);
+    const float a = buffer->samples[index];
+    const float b = buffer->samples[index + 1];
+    const float sample = a + ((b - a) * frac);
+
+    mix[f * MIX_CHANNELS] += sample * left;
+    mix[(f * MIX_CHANNELS) + 1] += sample * right;
+    voice->position += voice->step;
+  }
+  return true;
+}
+
+// Residual of a unit step smeared over one sample around t = 0 (mod 1)
+[[nodiscard]]
+static float PolyBlep(float t, float dt) {
+  if (t < dt) {
+    t /= dt;
+    return t + t - (t * t) - 1.0f;
+  }
+  if (t > 1.0f - dt) {
+    t = (t - 1.0f) / dt;
+    return (t * t) + t + t + 1.0f;
+  }
+  return 0.0f;
+}
+
+[[nodiscard]]
+static float ChirpSample(const ChirpState *chirp) {
+  const float t = chirp->phase;
+  const float half = t < 0.5f ? t + 0.5f : t - 0.5f;
+  const float naive = t < 0.5f ? 1.0f : -1.0f;
+  const float square = naive + PolyBlep(t, chirp->increment) -
+                       PolyBlep(half, chirp->increment);
+
+  const float attack = (float)chirp->frame * chirp->attack_step;
+  return square * (attack < 1.0f ? attack : 1.0f) * chirp->envelope;
+}
+
+static void AdvanceChirp(ChirpState *chirp) {
+  chirp->phase += chirp->increment;
+  if (chirp->phase >= 1.0f) {
+    chirp->phase -= 1.0f;
+  }
+  chirp->increment += chirp->sweep;
+  chirp->envelope *= chirp->decay;
+  chirp->frame++;
+}
+
+#if defined(__SSE2__)
+// Four frames at once. Phase, envelope and attack for lanes k = 0..3 come
+// in closed form from the block's first frame, so lanes stay independent:
+//   phase + k*inc + k(k-1)/2*sweep,  envelope * decay^k
+[[nodiscard]]
+static __m128 PolyBlep4(__m128 t, __m128 dt, __m128 inv_dt) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 low_x = _mm_mul_ps(t, inv_dt);
+  const __m128 low = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(low_x, low_x),
+                                           _mm_mul_ps(low_x, low_x)),
+                                one);
+  const __m128 high_x = _mm_mul_ps(_mm_sub_ps(t, one), inv_dt);
+  const __m128 high = _mm_add_ps(_mm_add_ps(_mm_mul_ps(high_x, high_x),
+                                            _mm_add_ps(high_x, high_x)),
+                                 one);
+  const __m128 is_low = _mm_cmplt_ps(t, dt);
+  const __m128 is_high = _mm_cmpgt_ps(t, _mm_sub_ps(one, dt));
+  return _mm_or_ps(_mm_and_ps(is_low, low), _mm_and_ps(is_high, high));
+}
+
+// `gains` is the voice's {left, right, left, right} with its level folded
+// in: panning is two multiplies per four frames, inside the same pass.
+static void MixChirpBlock(ChirpState *chirp, float *mix, __m128 gains) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+  const __m128 lane_sweep = _mm_set_ps(3.0f, 1.0f, 0.0f, 0.0f);
+  const float decay = chirp->decay;
+  const float decay2 = decay * decay;
+
+  // Increments stay below CHIRP_MAX_INCREMENT, so one wrap is enough
+  __m128 t = _mm_add_ps(
+      _mm_set1_ps(chirp->phase),
+      _mm_add_ps(_mm_mul_ps(lane, _mm_set1_ps(chirp->increment)),
+                 _mm_mul_ps(lane_sweep, _mm_set1_ps(chirp->sweep))));
+  t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpge_ps(t, one), one));
+  __m128 t_half = _mm_add_ps(t, half);
+  t_half = _mm_sub_ps(t_half, _mm_and_ps(_mm_cmpge_ps(t_half, one), one));
+
+  const __m128 rising = _mm_cmplt_ps(t, half);
+  const __m128 naive = _mm_or_ps(_mm_and_ps(rising, one),
+                                 _mm_andnot_ps(rising, _mm_set1_ps(-1.0f)));
+  const __m128 dt = _mm_set1_ps(chirp->increment);
+  const __m128 inv_dt = _mm_set1_ps(1.0f / chirp->increment);
+  const __m128 square =
+      _mm_sub_ps(_mm_add_ps(naive, PolyBlep4(t, dt, inv_dt)),
+                 PolyBlep4(t_half, dt, inv_dt));
+
+  const __m128 attack = _mm_min_ps(
+      _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)chirp->frame), lane),
+                 _mm_set1_ps(chirp->attack_step)),
+      one);
+  const __m128 envelope =
+      _mm_mul_ps(_mm_set1_ps(chirp->envelope),
+                 _mm_set_ps(decay2 * decay, decay2, decay, 1.0f));
+  const __m128 sample = _mm_mul_ps(square, _mm_mul_ps(attack, envelope));
+
+  // Mono into panned interleaved stereo: {s0 s0 s1 s1} {s2 s2 s3 s3}
+  _mm_storeu_ps(mix, _mm_add_ps(_mm_loadu_ps(mix),
+                                _mm_mul_ps(_mm_unpacklo_ps(sample, sample),
+                                           gains)));
+  _mm_storeu_ps(mix + 4,
+                _mm_add_ps(_mm_loadu_ps(mix + 4),
+                           _mm_mul_ps(_mm_unpackhi_ps(sample, sample), gains)));
+
+  chirp->phase += (4.0f * chirp->increment) + (6.0f * chirp->sweep);
+  chirp->phase -= floorf(chirp->phase);
+  chirp->increment += 4.0f * chirp->sweep;
+  chirp->envelope *= decay2 * decay2;
+  chirp->frame += 4;
+}
+#endif
+
+// Renders a synthesized voice into the mix. Returns false once it has ended.
+[[nodiscard]]
+static bool MixChirpVoice(Voice *voice, float *mix, uint32_t frames) {
+  ChirpState *chirp = &voice->chirp;
+  const float level = voice->gain * chirp->amplitude;
+  const float left = level * voice->pan_left;
+  const float right = level * voice->pan_right;
+  uint32_t f = 0;
+
+#if defined(__SSE2__)
+  static_assert(MIX_CHANNELS == 2, "MixChirpBlock writes stereo pairs");
+  const __m128 gains = _mm_set_ps(right, left, right, left);
+  for (; f + 4 <= frames && chirp->frame + 4 <= chirp->frames; f += 4) {
+    MixChirpBlock(chirp, mix + ((size_t)f * MIX_CHANNELS), gains);
+  }
+#endif
+  for (; f < frames && chirp->frame < chirp->frames; f++) {
+    const float sample = ChirpSample(chirp);
+    mix[f * MIX_CHANNELS] += sample * left;
+    mix[(f * MIX_CHANNELS) + 1] += sample * right;
+    AdvanceChirp(chirp);
+  }
+  return chirp->frame < chirp->frames;
+}
+
+// Sums every active voice into `mix` (interleaved stereo). Returns false when
+// nothing is playing so the caller can hand the device a silent buffer.
+bool MixVoices(float *mix, uint32_t frames) {
+  bool audible = false;
+  memset(mix, 0, sizeof(float) * MIX_CHANNELS * frames);
+
+  for (int i = 0; i < pool_config.voices; i++) {
+    Voice *voice = &voices[i];
+    if (!voice->active)
+      continue;
+
+    audible = true;
+    const bool playing = voice->buffer != nullptr
+                             ? MixSampleVoice(voice, mix, frames)
+                             : MixChirpVoice(voice, mix, frames);
+    if (!playing) {
+      voice->active = false;
+      voice->buffer = nullptr; // Lets a draining bank buffer retire
+    }
+  }
+  return audible;
+}
+
+void BeginAudioPeriod(uint32_t device_rate) {
+  EnterHotPath(); // Until EndAudioPeriod: the mix runs in between
+  AdoptPendingSounds();
+  DrainVoiceTriggers(device_rate, &pending_submits);
+}
+
+void EndAudioPeriod(void) {
+  RecordSubmits(&pending_submits);
+  LeaveHotPath();
+}
+
+// The event that woke the engine up is still fresh; clicks queued while a
+// lost device was being reopened are stale by then.
+void DiscardQueuedTriggers(void) {
+  for (int word = 0; word < READY_WORDS; word++) {
+    (void)atomic_exchange(&ready_queues[word], 0);
+    backlog_queues[word] = 0;
+  }
+  for (int i = 0; i < trigger_queue_count; i++) {
+    TriggerQueue *queue = &trigger_queues[i];
+    VoiceTrigger stale;
+    while (TriggerRingPop(&queue->ring, &stale)) {
+    }
+    for (int slot = 0; slot < SOUND_SLOT_COUNT; slot++) {
+      atomic_store(&queue->folded[slot], 0);
+    }
+    queue->deficit = 0;
+  }
+  pending_submits.count = 0;
+}
+
+void SilenceVoices(void) {
+  for (int i = 0; i < pool_config.voices; i++) {
+    voices[i] = (Voice){0};
+  }
+}
+
+// ============================================================
+// IDLE PARKING (Render thread, plus the wake in PushVoiceTrigger)
+// ============================================================
+bool AudioWantsPark(void) {
+  if (audio_config.park_after_ms == 0)
+    return false;
+
+  const int64_t now = NowTicks();
+  for (int i = 0; i < pool_config.voices; i++) {
+    if (voices[i].active) {
+      last_audible_ticks = now;
+      return false;
+    }
+  }
+  if (last_audible_ticks == 0) {
+    last_audible_ticks = now; // First silent period since the engine started
+  }
+  return now - last_audible_ticks >=
+         (int64_t)audio_config.park_after_ms * clock_ticks_per_second / 1000;
+}
+
+[[nodiscard]]
+static bool TriggersWaiting(void) {
+  for (int word = 0; word < READY_WORDS; word++) {
+    if (backlog_queues[word] != 0 ||
+        atomic_load_explicit(&ready_queues[word], memory_order_relaxed) != 0)
+      return true;
+  }
+  return false;
+}
+
+// Either this sees the ready bit a producer just set, or that producer
+// sees the flag and wakes us; the fences order the flag and the bits.
+bool ParkAudio(void) {
+  atomic_store(&audio_parked, true);
+  atomic_thread_fence(memory_order_seq_cst);
+  if (TriggersWaiting() && atomic_exchange(&audio_parked, false))
+    return false; // Nobody saw the flag, so nobody is going to wake us
+  CountStat(STAT_PARKS, 1);
+  return true;
+}
+
+static void TouchPages(const void *memory, size_t bytes) {
+  const volatile uint8_t *page = memory;
+  for (size_t offset = 0; offset < bytes; offset += PREWARM_STRIDE) {
+    (void)page[offset];
+  }
+  if (bytes > 0) {
+    (void)page[bytes - 1]; // The tail may start a page of its own
+  }
+}
+
+// The backend may have trimmed our working set while parked. Fault the
+// bank and the mixer state back in here, not inside the first period.
+// The first period then drops triggers read more than AUDIO_WAKE_STALE_MS
+// ago, a slow reopen's waking event among them; later ones all play.
+void UnparkAudio(void) {
+  for (int i = 0; i < SOUND_SLOT_COUNT; i++) {
+    const SoundBuffer *live = sound_bank[i].live;
+    if (live != nullptr) {
+      TouchPages(live, sizeof(SoundBuffer) +
+                           sizeof(float) * ((size_t)live->frames + 1));
+    }
+  }
+  TouchPages(voices, sizeof(Voice) * (size_t)pool_config.voices);
+  TouchPages(trigger_queues,
+             sizeof(TriggerQueue) * (size_t)trigger_queue_count);
+  TouchPages(&pending_submits, sizeof(pending_submits));
+
+  const int64_t woken = atomic_exchange(&wake_read_ticks, 0);
+  if (woken != 0) {
+    RecordLatency(LATENCY_WAKE, woken);
+  }
+  last_audible_ticks = NowTicks();
+  stale_before_ticks =
+      last_audible_ticks - AUDIO_WAKE_STALE_MS * clock_ticks_per_second / 1000;
+}
+
+// ============================================================
+// AUDIO ENGINE STARTUP
+// ============================================================
+// Constant power: left^2 + right^2 is the same at every position, so a
+// click keeps its loudness as it moves. Scaled by sqrt(2) so the centre,
+// and every unpositioned event, plays at unit gain on both channels.
+static void BuildPanTable(void) {
+  pan_table[PAN_NONE][0] = 1.0f;
+  pan_table[PAN_NONE][1] = 1.0f;
+  for (int i = 1; i <= PAN_POSITIONS; i++) {
+    const float offset = (float)(i - 1) / (float)(PAN_POSITIONS - 1) - 0.5f;
+    const float angle = PAN_QUARTER_TURN * (0.5f + (offset * pan_width));
+    pan_table[i][0] = sqrtf(2.0f) * cosf(angle);
+    pan_table[i][1] = sqrtf(2.0f) * sinf(angle);
+  }
+}
+
+// The device and the sound bank both wait for the first event, so a daemon
+// launched with the editor is listening before either of them loads.
+// Callers racing the first init spin until the trigger ring is usable.
+static void EnsureAudioEngine(void) {
+  if (atomic_load_explicit(&audio_engine_state, memory_order_acquire) ==
+      ENGINE_RUNNING)
+    return;
+
+  int expected = ENGINE_IDLE;
+  if (atomic_compare_exchange_strong(&audio_engine_state, &expected,
+                                     ENGINE_STARTING)) {
+    BuildPanTable();
+    const int depth = PauseHotPath(); // Threads, COM and WAVs, just once
+    PlatformStartAudio();
+    ResumeHotPath(depth);
+    atomic_store_explicit(&audio_engine_state, ENGINE_RUNNING,
+                          memory_order_release);
+    return;
+  }
+  while (atomic_load_explicit(&audio_engine_state, memory_order_acquire) !=
+         ENGINE_RUNNING) {
+    PlatformYield();
+  }
+}
+
+// ============================================================
+// TRACE RECORDING (Every decoded event, written off the hot path)
+// ============================================================
+static void RecordEvent(const ClientSession *session,
+                        const ClackEvent *event, int64_t read_ticks) {
+  const TraceRecord record = {
+      .ticks = read_ticks - trace_start_ticks,
+      .code = event->code,
+      .intensity = event->intensity,
+      .pan = event->pan,
+      .client = session->trace_id,
+  };
+  if (!TraceRingPush(&trace_queue, record)) {
+    atomic_fetch_add_explicit(&trace_dropped, 1, memory_order_relaxed);
+  }
+}
+
+static void RecordLegacyBytes(const ClientSession *session,
+                              const uint8_t *data, uint32_t count,
+                              int64_t read_ticks) {
+  for (uint32_t i = 0; i < count; i++) {
+    const ClackEvent event = {.code = data[i], .intensity = INTENSITY_FULL};
+    RecordEvent(session, &event, read_ticks);
+  }
+}
+
+// ============================================================
+// INTENSITY BUS (Transports count, one thread publishes)
+// ============================================================
+// Two relaxed adds per batch; the publisher does the rest
+static void CountBusActivity(uint64_t events, uint8_t effects) {
+  atomic_fetch_add_explicit(&bus_events, (unsigned)events,
+                            memory_order_relaxed);
+  if ((effects & BUS_BURST_EFFECTS) != 0) {
+    atomic_fetch_add_explicit(&bus_bursts, 1, memory_order_relaxed);
+  }
+}
+
+// A daemon that died mid-write may have left `sequence` odd
+static void PublishBusSample(IntensityBus *bus, uint32_t events, float rate,
+                             float burst, int64_t now) {
+  const uint32_t sequence =
+      atomic_load_explicit(&bus->sequence, memory_order_relaxed) & ~1u;
+  atomic_store_explicit(&bus->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  bus->events += events;
+  bus->stamp_ticks = now;
+  bus->rate = rate;
+  bus->burst = burst;
+  atomic_store_explicit(&bus->sequence, sequence + 2, memory_order_release);
+}
+
+// Samples at frame pace while editors are active, then polls slowly. No
+// sample is written while nothing arrives: readers decay the last one.
+static void IntensityBusThread(void) {
+  IntensityBus *bus = intensity_bus;
+  const double ms_per_tick = 1000.0 / (double)clock_ticks_per_second;
+  float rate = 0.0f;
+  float burst = 0.0f;
+  int64_t last = NowTicks();
+  while (true) {
+    const uint32_t events =
+        atomic_exchange_explicit(&bus_events, 0, memory_order_relaxed);
+    const uint32_t bursts =
+        atomic_exchange_explicit(&bus_bursts, 0, memory_order_relaxed);
+    const int64_t now = NowTicks();
+    if (events > 0 || bursts > 0) {
+      const float elapsed_ms = (float)((double)(now - last) * ms_per_tick);
+      rate = rate * expf(-elapsed_ms / BUS_RATE_TAU_MS) +
+             (float)events * 1000.0f / BUS_RATE_TAU_MS;
+      burst = bursts > 0 ? 1.0f : burst * expf(-elapsed_ms / BUS_BURST_TAU_MS);
+      PublishBusSample(bus, events, rate, burst, now);
+      last = now;
+    }
+    const bool lingering =
+        (double)(now - last) * ms_per_tick < (double)BUS_LINGER_MS;
+    PlatformSleep(lingering ? BUS_FRAME_MS : BUS_IDLE_MS);
+  }
+}
+
+void StartIntensityBus(void) {
+  if (!bus_enabled)
+    return;
+  IntensityBus *bus = PlatformMapBus(sizeof(IntensityBus));
+  if (bus == nullptr) {
+    DaemonLog("Intensity bus unavailable; effects get no activity signal\n");
+    return;
+  }
+  // A daemon we took over from leaves its last sample; readers keep
+  // decaying it until ours lands
+  bus->magic = BUS_MAGIC;
+  bus->version = BUS_VERSION;
+  bus->ticks_per_second = clock_ticks_per_second;
+  bus->rate_tau_ms = BUS_RATE_TAU_MS;
+  bus->burst_tau_ms = BUS_BURST_TAU_MS;
+  intensity_bus = bus;
+  if (!PlatformStartThread(IntensityBusThread)) {
+    DaemonLog("Could not start the intensity bus publisher\n");
+  }
+}
+
+// ============================================================
+// LOGIC HELPERS (Complexity Reduction)
+// ============================================================
+
+// 1. Encapsulate Sound Selection & Side Effects
+static void AccumulateAction(EventBatch *batch, EventAction action,
+                             uint8_t intensity, uint8_t pan) {
+  const float level = (float)intensity * (float)action.gain /
+                      ((float)INTENSITY_FULL * (float)EVENT_GAIN_UNITY);
+  batch->counts[action.lane]++;
+  batch->peak_level[action.lane] =
+      fmaxf(batch->peak_level[action.lane], level);
+  if (action.jitter > batch->jitter[action.lane]) {
+    batch->jitter[action.lane] = action.jitter;
+  }
+  if (pan != PAN_NONE && pan <= PAN_POSITIONS) { // Rings are client memory
+    batch->pan[action.lane] = pan;
+  }
+  batch->effects |= action.effects;
+}
+
+static void AccumulateEvent(EventBatch *batch, const ClackEvent *event) {
+  const EventTable *table =
+      atomic_load_explicit(&event_table, memory_order_acquire);
+  AccumulateAction(batch, table->actions[event->code], event->intensity,
+                   event->pan);
+}
+
+// Legacy bytes carry no intensity; every one plays at full strength
+static void AccumulateLegacyBytes(EventBatch *batch, const uint8_t *data,
+                                  uint32_t count) {
+  const EventTable *table =
+      atomic_load_explicit(&event_table, memory_order_acquire);
+  for (uint32_t i = 0; i < count; i++) {
+    AccumulateAction(batch, table->actions[data[i]], INTENSITY_FULL,
+                     PAN_NONE);
+  }
+}
+
+// 2. Encapsulate the Rate Limiter
+static void ResetRateLimiter(RateLimiter *limiter) {
+  const int64_t now = NowTicks();
+  for (int lane = 0; lane < EVENT_LANE_COUNT; lane++) {
+    limiter->lanes[lane] = (LaneLimiter){
+        .tokens = TOKEN_BUCKET_CAPACITY, .last_refill = now, .window_end = 0};
+  }
+}
+
+[[nodiscard]]
+static Admission AdmitEvents(LaneLimiter *limiter, int64_t now) {
+  const float refill = (float)(now - limiter->last_refill) *
+                       TOKEN_REFILL_PER_SECOND /
+                       (float)clock_ticks_per_second;
+  limiter->tokens = limiter->tokens + refill > TOKEN_BUCKET_CAPACITY
+                        ? TOKEN_BUCKET_CAPACITY
+                        : limiter->tokens + refill;
+  limiter->last_refill = now;
+
+  if (now < limiter->window_end || limiter->tokens < 1.0f)
+    return ADMIT_MERGE;
+
+  limiter->tokens -= 1.0f;
+  limiter->window_end =
+      now + (COALESCE_WINDOW_MS * clock_ticks_per_second / 1000);
+  return ADMIT_START;
+}
+
+// 3. Encapsulate the Playback Decision for a whole batch
+// A full queue means this client is outrunning the render thread. The
+// newest triggers fold into a per-slot count the render thread plays as
+// one voice; the stale clicks queued ahead of them are what it sheds.
+static void PushVoiceTrigger(const ClientSession *session,
+                             VoiceTrigger trigger) {
+  EnsureAudioEngine();
+  const int index = session->queue;
+  TriggerQueue *queue = &trigger_queues[index];
+  if (!TriggerRingPush(&queue->ring, trigger)) {
+    atomic_fetch_add(&queue->folded[trigger.slot], trigger.count);
+    CountStat(STAT_FOLDS, 1);
+  }
+  atomic_fetch_or(&ready_queues[index / 64], 1ull << (index % 64));
+  atomic_thread_fence(memory_order_seq_cst); // Pairs with ParkAudio
+  if (atomic_load_explicit(&audio_parked, memory_order_relaxed) &&
+      atomic_exchange(&audio_parked, false)) {
+    atomic_store(&wake_read_ticks, trigger.read_ticks);
+    PlatformWakeAudio();
+  }
+}
+
+static void DispatchEventBatch(ClientSession *session,
+                               const EventBatch *batch, int64_t read_ticks) {
+  RateLimiter *limiter = &session->limiter;
+  const int64_t now = NowTicks();
+  uint64_t events = batch->counts[LANE_SILENT];
+
+  for (int slot = 0; slot < SOUND_SLOT_COUNT; slot++) {
+    if (batch->counts[slot] == 0)
+      continue;
+
+    events += batch->counts[slot];
+    if (LANE_RATE_LIMITED[slot] &&
+        AdmitEvents(&limiter->lanes[slot], now) == ADMIT_MERGE) {
+      PushVoiceTrigger(session, (VoiceTrigger){
+          .slot = (uint8_t)slot,
+          .kind = TRIGGER_MERGE,
+          .gain = batch->peak_level[slot],
+          .count = batch->counts[slot],
+          .read_ticks = read_ticks,
+      });
+      continue;
+    }
+    PushVoiceTrigger(session, (VoiceTrigger){
+        .slot = (uint8_t)slot,
+        .kind = TRIGGER_START,
+        .jitter = batch->jitter[slot],
+        .pan = batch->pan[slot],
+        .gain = BurstGain(batch->counts[slot], batch->peak_level[slot]),
+        .count = batch->counts[slot],
+        .read_ticks = read_ticks,
+    });
+  }
+
+  if ((batch->effects & EFFECT_SHAKE) != 0) {
+    PlatformShake(&session->target);
+  }
+  if ((batch->effects & EFFECT_FLASH) != 0) {
+    PlatformFlash(&session->target);
+  }
+  CountBusActivity(events, batch->effects);
+  CountStat(STAT_EVENTS, events);
+  CountStat(STAT_BATCHES, 1);
+}
+
+// 4. Encapsulate Protocol Detection (magic + hello header)
+// Returns hello bytes consumed, 0 while more input is needed.
+[[nodiscard]]
+static uint32_t DetectProtocol(ClientSession *session, const uint8_t *data,
+                               uint32_t count) {
+  const uint32_t compared = count < sizeof(PROTOCOL_MAGIC)
+                                ? count
+                                : (uint32_t)sizeof(PROTOCOL_MAGIC);
+  if (memcmp(data, PROTOCOL_MAGIC, compared) != 0) {
+    session->protocol = PROTOCOL_LEGACY;
+    return 0;
+  }
+  if (count < HELLO_HEADER_BYTES)
+    return 0;
+
+  // Any version >= 1 is framed; extra hello fields are skipped by length
+  const uint32_t hello_bytes = HELLO_HEADER_BYTES + data[5];
+  if (data[4] < PROTOCOL_VERSION) {
+    session->protocol = PROTOCOL_LEGACY;
+    return 0;
+  }
+  if (count < hello_bytes)
+    return 0;
+
+  const uint8_t *fields = data + HELLO_HEADER_BYTES;
+  if (data[5] >= HELLO_PID_LEN) {
+    session->target.pid = ReadLE32(fields);
+  }
+  if (data[5] >= HELLO_WINDOW_LEN) {
+    session->target.window = ReadLE64(fields + HELLO_PID_LEN);
+  }
+  session->protocol = PROTOCOL_FRAMED;
+  return hello_bytes;
+}
+
+// Cell `col` of a grid `columns` wide, as a ClackEvent pan
+[[nodiscard]]
+static uint8_t PanForColumn(uint32_t col, uint32_t columns) {
+  if (columns < 2)
+    return PAN_NONE;
+  const uint32_t last = columns - 1;
+  const uint32_t cell = col < last ? col : last;
+  return (uint8_t)(1u + ((cell * (PAN_POSITIONS - 1)) + (last / 2)) / last);
+}
+
+// 5. Encapsulate Frame Decoding
+// Consumes every complete frame; an incomplete tail is left for the next
+// read. Returns false on a malformed frame so the caller drops the client.
+[[nodiscard]]
+static bool DecodeFrames(const ClientSession *session, const uint8_t *data,
+                         uint32_t count, int64_t read_ticks, EventBatch *batch,
+                         uint32_t *consumed) {
+  uint32_t offset = 0;
+  while (offset < count) {
+    const uint8_t len = data[offset];
+    if (len < EVENT_MIN_LEN)
+      return false;
+    if (count - offset < 1u + len)
+      break;
+
+    const uint8_t *frame = data + offset + 1;
+    const ClackEvent event = {
+        .code = frame[0],
+        .timestamp_ms = ReadLE32(frame + 1),
+        .intensity = (len >= EVENT_INTENSITY_LEN) ? frame[5] : INTENSITY_FULL,
+        .pan = (len >= EVENT_POSITION_LEN)
+                   ? PanForColumn(ReadLE16(frame + 6), ReadLE16(frame + 10))
+                   : PAN_NONE,
+    };
+    AccumulateEvent(batch, &event);
+    if (trace_recording) {
+      RecordEvent(session, &event, read_ticks);
+    }
+    offset += 1u + len;
+  }
+  *consumed = offset;
+  return true;
+}
+
+// 6. Encapsulate Per-Read Processing (both protocol flavours)
+[[nodiscard]]
+static bool ConsumeClientBytes(ClientSession *session, uint32_t count,
+                               int64_t read_ticks, EventBatch *batch,
+                               uint32_t *consumed) {
+  const uint8_t *data = session->buffer;
+  uint32_t offset = 0;
+
+  if (session->protocol == PROTOCOL_UNKNOWN) {
+    offset = DetectProtocol(session, data, count);
+    if (session->protocol == PROTOCOL_UNKNOWN) {
+      *consumed = 0; // Still waiting on the rest of the hello
+      return true;
+    }
+  }
+
+  if (session->protocol == PROTOCOL_LEGACY) {
+    AccumulateLegacyBytes(batch, data + offset, count - offset);
+    if (trace_recording) {
+      RecordLegacyBytes(session, data + offset, count - offset, read_ticks);
+    }
+    *consumed = count;
+    return true;
+  }
+
+  uint32_t frame_bytes = 0;
+  const bool ok = DecodeFrames(session, data + offset, count - offset,
+                               read_ticks, batch, &frame_bytes);
+  *consumed = offset + frame_bytes;
+  return ok;
+}
+
+// ============================================================
+// SESSIONS (Whatever the transport, one ClientSession per client)
+// ============================================================
+// Queue 0 is never claimed: it takes whoever finds the rest in use
+[[nodiscard]]
+static int ClaimTriggerQueue(void) {
+  for (int i = 1; i < trigger_queue_count; i++) {
+    bool expected = false;
+    if (atomic_compare_exchange_strong(&trigger_queues[i].claimed, &expected,
+                                       true))
+      return i;
+  }
+  return 0;
+}
+
+void SessionOpen(ClientSession *session) {
+  session->queue = ClaimTriggerQueue();
+  session->trace_id = (uint8_t)atomic_fetch_add(&trace_next_id, 1);
+  session->protocol = PROTOCOL_UNKNOWN;
+  session->buffered = 0;
+  session->target = (EffectTarget){0};
+  ResetRateLimiter(&session->limiter);
+  CountStat(STAT_CONNECTS, 1);
+}
+
+bool SessionReceive(ClientSession *session, uint32_t bytes,
+                    int64_t read_ticks) {
+  uint32_t consumed = 0;
+  EventBatch batch = {0};
+  const uint32_t available = session->buffered + bytes;
+  EnterHotPath();
+  if (!ConsumeClientBytes(session, available, read_ticks, &batch,
+                          &consumed)) {
+    LeaveHotPath();
+    CountStat(STAT_PROTOCOL_ERRORS, 1);
+    SessionClosed(session);
+    return false;
+  }
+  DispatchEventBatch(session, &batch, read_ticks);
+  RecordLatency(LATENCY_DECODE, read_ticks);
+  LeaveHotPath();
+
+  // Frames are at most 256 bytes, so the tail always leaves room to read
+  session->buffered = available - consumed;
+  memmove(session->buffer, session->buffer + consumed, session->buffered);
+  return true;
+}
+
+// Whatever it still has queued plays out; the next owner only adds to it
+void SessionClosed(ClientSession *session) {
+  if (session->queue != 0) {
+    atomic_store(&trigger_queues[session->queue].claimed, false);
+    session->queue = 0;
+  }
+  CountStat(STAT_DISCONNECTS, 1);
+}
+
+void SessionDeliver(ClientSession *session, const ClackEvent *events,
+                    uint32_t count, int64_t read_ticks) {
+  EventBatch batch = {0};
+  EnterHotPath();
+  for (uint32_t i = 0; i < count; i++) {
+    AccumulateEvent(&batch, &events[i]);
+    if (trace_recording) {
+      RecordEvent(session, &events[i], read_ticks);
+    }
+  }
+  DispatchEventBatch(session, &batch, read_ticks);
+  RecordLatency(LATENCY_DECODE, read_ticks);
+  LeaveHotPath();
+}
+
+// ============================================================
+// CONTROL COMMANDS (Parsed here, transported by the backend)
+// ============================================================
+// Commands are one message each; the reply is one line.
+//   ping     -> "ok <pid>"
+//   reload   re-read every sound-bank override now
+//   ring <pid>  claim a shared-memory ring for that process -> "ok <index>"
+//   handoff  exit so a --takeover launch can own the session; its
+//            listeners are already up, so clients just reconnect
+//   quit     exit without a successor
+ControlAction HandleControlCommand(const char *command, char *reply,
+                                   size_t capacity) {
+  if (strcmp(command, "ping") == 0) {
+    snprintf(reply, capacity, "ok %lu\n", PlatformProcessId());
+  } else if (strcmp(command, "reload") == 0) {
+    PlatformRequestReload();
+    snprintf(reply, capacity, "ok\n");
+  } else if (strncmp(command, "ring ", 5) == 0) {
+    // ring <pid> [<window>]: the window is optional, as in the hello
+    char *rest = nullptr;
+    EffectTarget owner = {.pid = (uint32_t)strtoul(command + 5, &rest, 10)};
+    owner.window = strtoull(rest, nullptr, 10);
+    const int ring = PlatformClaimRing(&owner);
+    if (ring < 0) {
+      snprintf(reply, capacity, "error no ring available\n");
+    } else {
+      snprintf(reply, capacity, "ok %d\n", ring);
+    }
+  } else if (strcmp(command, "handoff") == 0 || strcmp(command, "quit") == 0) {
+    snprintf(reply, capacity, "ok\n");
+    return CONTROL_EXIT;
+  } else {
+    snprintf(reply, capacity, "error unknown command\n");
+  }
+  return CONTROL_CONTINUE;
+}
+
+// ============================================================
+// COMMAND LINE
+// ============================================================
+//   --shared          Share the endpoint with other apps (default)
+//   --exclusive       Own the endpoint; lowest latency, blocks other audio
+//   --period-ms <n>   Requested device period, clamped to what the driver
+//                     supports (default 3 ms)
+//   --park-after <s>  Release the audio stream after this much silence
+//                     (default 60 s; 0 keeps it open)
+//   --pan-width <n>   Percent of the stereo field cursor positions span
+//                     (default 100; 0 plays every click centred)
+//   --shake-ms <n>    Shake animation length (default 300 ms)
+//   --shake-px <n>    Shake peak amplitude (default 15 px at 100% scale)
+//   --shake-style <s> "move" the terminal (default) or shake an "overlay"
+//                     snapshot of it, leaving the real window in place
+//   --no-mmcss        Keep the audio and event threads out of MMCSS
+//   --affinity <mask> Pin those threads to a CPU mask (0x0c = CPUs 2 and 3)
+//   --allow-ecoqos    Let Windows throttle the daemon like other background
+//                     processes (it opts out by default)
+//   --voices <n>      Voices mixed at once (default 16)
+//   --clients <n>     Editors served at once (default 16)
+//   --takeover        Replace an already running daemon instead of exiting
+//   --events <file>   Event map to use instead of clack_events.conf
+//   --no-bus          Don't publish the intensity bus for visual effects
+//   --record <file>   Log every decoded event to a trace file
+//   --replay <file>   Play a trace back instead of serving editors
+//   --speed <x>       Replay time scale (default 1; 2 plays twice as fast)
+static const char *record_path = nullptr;
+static const char *replay_path = nullptr;
+static double replay_speed = 1.0;
+
+static void ParseArguments(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--shared") == 0) {
+      audio_config.exclusive = false;
+    } else if (strcmp(argv[i], "--exclusive") == 0) {
+      audio_config.exclusive = true;
+    } else if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc) {
+      audio_config.period_ms = strtod(argv[++i], nullptr);
+    } else if (strcmp(argv[i], "--pan-width") == 0 && i + 1 < argc) {
+      pan_width = strtof(argv[++i], nullptr) / 100.0f;
+    } else if (strcmp(argv[i], "--park-after") == 0 && i + 1 < argc) {
+      const unsigned long seconds = strtoul(argv[++i], nullptr, 10);
+      audio_config.park_after_ms =
+          (seconds > AUDIO_MAX_PARK_S ? AUDIO_MAX_PARK_S : (uint32_t)seconds) *
+          1000u;
+    } else if (strcmp(argv[i], "--shake-ms") == 0 && i + 1 < argc) {
+      shake_config.duration_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--shake-px") == 0 && i + 1 < argc) {
+      shake_config.amplitude_px = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--shake-style") == 0 && i + 1 < argc) {
+      const char *style = argv[++i];
+      if (strcmp(style, "overlay") == 0) {
+        shake_config.style = SHAKE_STYLE_OVERLAY;
+      } else if (strcmp(style, "move") == 0) {
+        shake_config.style = SHAKE_STYLE_MOVE;
+      } else {
+        DaemonLog("Unknown shake style \"%s\"; moving the window\n", style);
+      }
+    } else if (strcmp(argv[i], "--no-mmcss") == 0) {
+      scheduling_config.mmcss = false;
+    } else if (strcmp(argv[i], "--affinity") == 0 && i + 1 < argc) {
+      scheduling_config.affinity = strtoull(argv[++i], nullptr, 0);
+    } else if (strcmp(argv[i], "--allow-ecoqos") == 0) {
+      scheduling_config.allow_ecoqos = true;
+    } else if (strcmp(argv[i], "--voices") == 0 && i + 1 < argc) {
+      pool_config.voices = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+      pool_config.clients = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--takeover") == 0) {
+      takeover_requested = true;
+    } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+      event_map_path = argv[++i];
+    } else if (strcmp(argv[i], "--no-bus") == 0) {
+      bus_enabled = false;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      replay_speed = strtod(argv[++i], nullptr);
+    } else {
+      DaemonLog("Ignoring unknown argument: %s\n", argv[i]);
+    }
+  }
+
+  if (pool_config.voices < 1 || pool_config.voices > VOICE_MAX_COUNT) {
+    pool_config.voices = VOICE_DEFAULT_COUNT;
+  }
+  if (pool_config.clients < 1 || pool_config.clients > MAX_POOL_CLIENTS) {
+    pool_config.clients = PIPE_POOL_SIZE;
+  }
+  if (shake_config.duration_ms < 1 ||
+      shake_config.duration_ms > SHAKE_MAX_DURATION_MS) {
+    shake_config.duration_ms = SHAKE_DEFAULT_DURATION_MS;
+  }
+  if (shake_config.amplitude_px < 0 ||
+      shake_config.amplitude_px > SHAKE_MAX_AMPLITUDE_PX) {
+    shake_config.amplitude_px = SHAKE_DEFAULT_AMPLITUDE_PX;
+  }
+
+  if (!(replay_speed >= REPLAY_MIN_SPEED)) {
+    replay_speed = REPLAY_MIN_SPEED; // Also catches NaN
+  } else if (replay_speed > REPLAY_MAX_SPEED) {
+    replay_speed = REPLAY_MAX_SPEED;
+  }
+
+  if (!(pan_width >= 0.0f)) {
+    pan_width = 0.0f; // Also catches NaN
+  } else if (pan_width > 1.0f) {
+    pan_width = 1.0f;
+  }
+
+  if (!(audio_config.period_ms >= AUDIO_MIN_PERIOD_MS)) {
+    audio_config.period_ms = AUDIO_MIN_PERIOD_MS; // Also catches NaN
+  } else if (audio_config.period_ms > AUDIO_MAX_PERIOD_MS) {
+    audio_config.period_ms = AUDIO_MAX_PERIOD_MS;
+  }
+}
+
+#if defined(CLICKER_LIBRARY)
+// ============================================================
+// EMBEDDED LIBRARY (clicker_core: the engine inside the editor)
+// ============================================================
+// No transport and no second process. The caller's thread decodes and
+// rate-limits like a pipe worker would; the audio thread is ours. Logging
+// stays off: the host's stdout is usually its UI. Only the library defines
+// these: the daemon sees clicker_api.h's dllimport declarations.
+static ClientSession embedded_session; // Caller thread only
+static bool embedded_ready = false;    // Caller thread only
+
+int clicker_init(void) {
+  if (embedded_ready)
+    return 0;
+  clock_ticks_per_second = PlatformClockRate();
+  daemon_start_ticks = NowTicks();
+  if (!StartEngineArena(0))
+    return 1;
+  ReloadEventMap(true);
+  if (!PlatformStartEmbedded())
+    return 1;
+  ArenaSeal();
+  SessionOpen(&embedded_session);
+  // The host editor is the client, so effects go to its own terminal
+  embedded_session.target = (EffectTarget){
+      .pid = (uint32_t)PlatformProcessId(),
+      .window = PlatformConsoleWindow(),
+  };
+  EnsureAudioEngine(); // Pay for the device now, not on the first key
+  embedded_ready = true;
+  return 0;
+}
+
+void clicker_play(uint8_t code, uint8_t intensity) {
+  clicker_play_at(code, intensity, 0, 0);
+}
+
+void clicker_play_at(uint8_t code, uint8_t intensity, uint16_t col,
+                     uint16_t columns) {
+  if (!embedded_ready)
+    return;
+  const ClackEvent event = {
+      .code = code,
+      .intensity = intensity,
+      .pan = PanForColumn(col, columns),
+  };
+  SessionDeliver(&embedded_session, &event, 1, NowTicks());
+}
+
+void clicker_shake(void) {
+  if (embedded_ready) {
+    PlatformShake(&embedded_session.target);
+  }
+}
+
+#else
+// ============================================================
+// TRACE CAPTURE & REPLAY (Daemon command line only)
+// ============================================================
+static constexpr uint32_t REPLAY_SPIN_MS = 16; // Covers a coarse OS sleep
+static constexpr uint32_t REPLAY_TAIL_MS = 500; // Lets the last voices end
+static constexpr size_t REPLAY_STATS_BYTES = 4096;
+
+static void WriteLE64(uint8_t *p, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    p[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+// Packs records into large writes and flushes whenever the queue runs
+// dry, so an abrupt exit loses at most the last few milliseconds.
+static void TraceWriterThread(void) {
+  static uint8_t chunk[TRACE_WRITE_RECORDS * TRACE_RECORD_BYTES];
+  uint64_t reported_drops = 0;
+  bool failed = false;
+  while (true) {
+    uint32_t count = 0;
+    TraceRecord record;
+    while (count < TRACE_WRITE_RECORDS &&
+           TraceRingPop(&trace_queue, &record)) {
+      uint8_t *out = chunk + (size_t)count * TRACE_RECORD_BYTES;
+      WriteLE64(out, (uint64_t)record.ticks);
+      out[8] = record.code;
+      out[9] = record.intensity;
+      out[10] = record.pan; // Reserved and zero before panning: PAN_NONE
+      out[11] = record.client;
+      count++;
+    }
+    // A dead disk keeps draining the ring so producers never see it full
+    if (count > 0 && !failed &&
+        fwrite(chunk, TRACE_RECORD_BYTES, count, trace_file) != count) {
+      DaemonLog("Trace write failed; recording stopped\n");
+      failed = true;
+    }
+    if (count == TRACE_WRITE_RECORDS)
+      continue;
+
+    if (!failed) {
+      fflush(trace_file);
+    }
+    const uint64_t drops =
+        atomic_load_explicit(&trace_dropped, memory_order_relaxed);
+    if (drops != reported_drops) {
+      DaemonLog("Trace queue full: %llu records lost so far\n",
+                (unsigned long long)drops);
+      reported_drops = drops;
+    }
+    PlatformSleep(TRACE_IDLE_MS);
+  }
+}
+
+static void StartRecording(const char *path) {
+  trace_file = fopen(path, "wb");
+  if (trace_file == nullptr) {
+    DaemonLog("Could not open trace %s; not recording\n", path);
+    return;
+  }
+  uint8_t header[TRACE_HEADER_BYTES] = {0};
+  memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  header[4] = TRACE_VERSION;
+  WriteLE64(header + 8, (uint64_t)clock_ticks_per_second);
+
+  TraceRingInit(&trace_queue);
+  if (fwrite(header, 1, sizeof(header), trace_file) != sizeof(header) ||
+      !PlatformStartThread(TraceWriterThread)) {
+    DaemonLog("Could not start recording to %s\n", path);
+    fclose(trace_file);
+    trace_file = nullptr;
+    return;
+  }
+  trace_start_ticks = NowTicks();
+  trace_recording = true;
+  DaemonLog("Recording events to %s\n", path);
+}
+
+// Sleeps most of the way, then yields until the deadline passes
+static void WaitUntil(int64_t due) {
+  const int64_t spin_ticks = REPLAY_SPIN_MS * clock_ticks_per_second / 1000;
+  while (due - NowTicks() > spin_ticks) {
+    PlatformSleep(1);
+  }
+  while (NowTicks() < due) {
+    PlatformYield();
+  }
+}
+
+// Each recorded read becomes one batch again, dispatched on its client's
+// session when its offset (scaled by --speed) comes round on our clock.
+// Every client gets its own rate limiter and trigger queue as it did
+// live, so the mixer sees the same shape of burst the editors produced,
+// and the stats are logged at the end for comparing runs.
+[[nodiscard]]
+static int ReplayTrace(const char *path, double speed) {
+  uint32_t size = 0;
+  uint8_t *image = PlatformReadFile(path, TRACE_MAX_FILE_BYTES, &size);
+  if (image == nullptr || size < TRACE_HEADER_BYTES ||
+      memcmp(image, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+      image[4] != TRACE_VERSION || ReadLE64(image + 8) == 0) {
+    DaemonLog("Not a trace file: %s\n", path);
+    free(image);
+    return EXIT_FAILURE;
+  }
+  if (!PlatformStartEmbedded()) {
+    DaemonLog("Could not start the audio services for replay\n");
+    free(image);
+    return EXIT_FAILURE;
+  }
+
+  const double tick_scale = (double)clock_ticks_per_second /
+                            ((double)ReadLE64(image + 8) * speed);
+  const uint32_t records = (size - TRACE_HEADER_BYTES) / TRACE_RECORD_BYTES;
+  const uint8_t *record = image + TRACE_HEADER_BYTES;
+  ClientSession *sessions = calloc(TRACE_CLIENT_COUNT, sizeof(*sessions));
+  bool opened[TRACE_CLIENT_COUNT] = {0};
+  if (sessions == nullptr) {
+    DaemonLog("Out of memory for replay sessions\n");
+    free(image);
+    return EXIT_FAILURE;
+  }
+  EnsureAudioEngine();
+  DaemonLog("Replaying %u events from %s at %.2fx\n", records, path, speed);
+
+  const int64_t start = NowTicks();
+  uint32_t replayed = 0;
+  while (replayed < records) {
+    const uint64_t ticks = ReadLE64(record);
+    const uint8_t client = record[11];
+    WaitUntil(start + (int64_t)((double)ticks * tick_scale));
+    if (!opened[client]) {
+      SessionOpen(&sessions[client]); // A client's first read connects it
+      opened[client] = true;
+    }
+
+    EventBatch batch = {0};
+    const int64_t read_ticks = NowTicks();
+    EnterHotPath();
+    while (replayed < records && ReadLE64(record) == ticks &&
+           record[11] == client) {
+      const ClackEvent event = {
+          .code = record[8], .intensity = record[9], .pan = record[10]};
+      AccumulateEvent(&batch, &event);
+      record += TRACE_RECORD_BYTES;
+      replayed++;
+    }
+    DispatchEventBatch(&sessions[client], &batch, read_ticks);
+    RecordLatency(LATENCY_DECODE, read_ticks);
+    LeaveHotPath();
+  }
+  free(image);
+  for (int i = 0; i < TRACE_CLIENT_COUNT; i++) {
+    if (opened[i]) {
+      SessionClosed(&sessions[i]);
+    }
+  }
+  free(sessions);
+
+  PlatformSleep(REPLAY_TAIL_MS);
+  char stats[REPLAY_STATS_BYTES];
+  if (FormatStatsJson(stats, sizeof(stats)) > 0) {
+    DaemonLog("%s", stats);
+  }
+  return EXIT_SUCCESS;
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+// Only the transport starts here. Audio and effects come up on the first
+// event that needs them (see EnsureAudioEngine and the backend's shake).
+int main(int argc, char **argv) {
+  log_enabled = PlatformHasOutputStream();
+  DaemonLog("Starting Neovim Sound Daemon (C23)...\n");
+  clock_ticks_per_second = PlatformClockRate();
+  ParseArguments(argc, argv);
+  daemon_start_ticks = NowTicks();
+  if (!StartEngineArena(pool_config.clients))
+    return EXIT_FAILURE;
+  ReloadEventMap(true); // 1 KB; every later reload rides on the sound bank
+  if (replay_path != nullptr)
+    return ReplayTrace(replay_path, replay_speed);
+  if (record_path != nullptr) {
+    StartRecording(record_path);
+  }
+  return PlatformRunDaemon();
 }
+#endif
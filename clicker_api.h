@@ -0,0 +1,35 @@
+#pragma once
+
+// C ABI of the clicker_core shared library: the same engine as the daemon,
+// loaded into the editor (init.lua uses ffi.load) with no pipe in between.
+// Call from one thread. The library owns its audio and effects threads and
+// is never unloaded, so they live as long as the host process.
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(CLICKER_LIBRARY)
+#define CLICKER_API __declspec(dllexport)
+#else
+#define CLICKER_API __declspec(dllimport)
+#endif
+#else
+#define CLICKER_API __attribute__((visibility("default")))
+#endif
+
+// Brings up the audio device and sound bank. Returns 0 on success (also
+// when already initialized); anything else means no sound will play.
+CLICKER_API int clicker_init(void);
+
+// One event, coded like the wire protocol: 'k' click, 's' space, 'e'
+// enter, 'x' shake. Intensity 255 is full strength. Rate-limited and
+// coalesced exactly like a daemon client.
+CLICKER_API void clicker_play(uint8_t code, uint8_t intensity);
+
+// Same, panned by the cursor: screen column `col` of a grid `columns`
+// wide. A grid narrower than two columns plays centred.
+CLICKER_API void clicker_play_at(uint8_t code, uint8_t intensity,
+                                 uint16_t col, uint16_t columns);
+
+// Shakes the terminal hosting this process (Windows only; no-op elsewhere)
+CLICKER_API void clicker_shake(void);
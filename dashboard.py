@@ -5,8 +5,13 @@ import threading
 import shutil
 import psutil
 import os
+import json
 import requests
 import socket
+import struct
+import math
+import mmap
+import time
 from pathlib import Path
 
 # Try to import the manager, handle gracefully if missing
@@ -21,6 +26,12 @@ except ImportError:
 # 1. CONFIG & THEME
 # ==============================================================================
 PROJECT_ROOT = Path("E:/")
+CLACK_STATS_PIPE = r"\\.\pipe\nvim_clack_stats"
+CLACK_BUS = r"Local\nvim_clack_bus"  # Intensity bus (IntensityBus in clicker.c)
+if os.name != "nt":
+    _runtime = (os.environ.get("XDG_RUNTIME_DIR") or os.environ.get("TMPDIR") or "/tmp").rstrip("/")
+    CLACK_STATS_PIPE = f"{_runtime}/nvim_clack_stats-{os.getuid()}.sock"
+    CLACK_BUS = f"{_runtime}/nvim_clack_bus-{os.getuid()}.shm"
 
 E = "\033["
 RESET = f"{E}0m"
@@ -44,6 +55,7 @@ ICON_PLUG = ""
 ICON_RAM = "󰍛"
 ICON_CPU = ""
 ICON_TEMP = ""
+ICON_AUDIO = "󰕾"
 
 
 # ==============================================================================
@@ -164,6 +176,52 @@ def get_cpu_temp():
     return None
 
 
+def get_clack_stats():
+    """Reads one JSON snapshot from the sound daemon's stats pipe"""
+    try:
+        # One message per connection; the daemon recycles the pipe once we close
+        if os.name != "nt":
+            with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+                sock.settimeout(0.5)
+                sock.connect(CLACK_STATS_PIPE)
+                return json.loads(sock.recv(4096))
+        with open(CLACK_STATS_PIPE, "rb", buffering=0) as pipe:
+            return json.loads(pipe.read(4096))
+    except (OSError, ValueError):
+        return None
+
+
+def get_clack_intensity():
+    """Typing rate (events/s) and burst level (0-1) from the intensity bus, decayed to now"""
+    try:
+        if os.name == "nt":
+            bus = mmap.mmap(-1, 64, tagname=CLACK_BUS, access=mmap.ACCESS_READ)
+            now_ns = time.perf_counter_ns()  # QueryPerformanceCounter, like the daemon
+        else:
+            with open(CLACK_BUS, "rb") as f:
+                bus = mmap.mmap(f.fileno(), 64, access=mmap.ACCESS_READ)
+            now_ns = time.clock_gettime_ns(time.CLOCK_MONOTONIC)
+        with bus:
+            for _ in range(4):  # Odd sequence = mid-write; retry
+                before = struct.unpack_from("<I", bus, 8)[0]
+                magic, version, _, _, stamp, tps, rate, burst, rate_tau, burst_tau = struct.unpack_from("<IIIIqqffff", bus)
+                if before % 2 == 0 and struct.unpack_from("<I", bus, 8)[0] == before:
+                    break
+            else:
+                return None
+    except (OSError, ValueError):
+        return None
+    if magic != 0x5342434E or version != 1 or tps == 0:
+        return None
+    age_ms = max(0.0, (now_ns * tps / 1e9 - stamp) * 1000 / tps)
+    return rate * math.exp(-age_ms / rate_tau), burst * math.exp(-age_ms / burst_tau)
+
+
+def format_latency(us):
+    color = C_GREEN if us < 2000 else (C_GOLD if us < 10000 else C_RED)
+    return f"{color}{us / 1000:.1f}ms{RESET}"
+
+
 def draw_bar(percent, width=15):
     fill_len = int(width * percent / 100)
     empty_len = width - fill_len
@@ -196,6 +254,8 @@ def show_dashboard():
     cpu_load = psutil.cpu_percent(interval=0.5)
     mem = psutil.virtual_memory()
     cpu_temp = get_cpu_temp() if is_lhm_alive() else "OFF"
+    clack = get_clack_stats()
+    intensity = get_clack_intensity()
     disk_c = int(shutil.disk_usage("C:/").used / shutil.disk_usage("C:/").total * 100)
     disk_d = 0
     disk_e = 0
@@ -243,6 +303,17 @@ def show_dashboard():
     print(
         f"  {C_GRAY}│{RESET} {ICON_RAM} RAM: {draw_bar(mem.percent)} {C_GRAY}|{RESET} {C_GRAY}{int(mem.used / 1024**3)}G/{int(mem.total / 1024**3)}G{RESET}"
     )
+    if clack:
+        submit = clack["submit"]
+        print(
+            f"  {C_GRAY}│{RESET} {ICON_AUDIO} SFX: p50 {format_latency(submit['p50_us'])} {C_GRAY}|{RESET} p99 {format_latency(submit['p99_us'])} {C_GRAY}|{RESET} max {format_latency(submit['max_us'])} {C_GRAY}|{RESET} {C_GRAY}{clack['events']} ev, {clack['drops']} drop, {clack['connects']} conn{RESET}"
+        )
+        if intensity:
+            rate, burst = intensity
+            heat = min(100, max(rate / 12 * 100, burst * 100))  # 12 keys/s ~ 144 WPM
+            print(f"  {C_GRAY}│{RESET} {ICON_AUDIO} KEY: {draw_bar(heat)} {C_GRAY}|{RESET} {C_GRAY}{rate:.1f} keys/s{RESET}")
+    else:
+        print(f"  {C_GRAY}│{RESET} {ICON_AUDIO} SFX: {C_GRAY}daemon offline{RESET}")
     print(f"  {C_GRAY}│{RESET}")
 
     # Storage
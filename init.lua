@@ -829,22 +829,62 @@ vim.api.nvim_set_hl(0, "LspReferenceWrite", { underline = true, bold = true, sp
 -- ==========================================================================
 -- AUTO-START CLICKER DAEMON
 -- ==========================================================================
+-- In-process engine (`vim.g.clack_engine = "library"` before this file
+-- runs): clicker_core is loaded with ffi.load and plays keys itself, with
+-- no daemon and no pipe. Falls back to the daemon if it can't load.
+local clack_engine = nil
+
+local function load_clack_engine(nvim_dir)
+    local ffi = require("ffi")
+    local library = vim.fn.has("win32") == 1 and "\\build\\clicker_core.dll"
+        or vim.fn.has("mac") == 1 and "/build/libclicker_core.dylib"
+        or "/build/libclicker_core.so"
+    pcall(ffi.cdef, [[
+        int clicker_init(void);
+        void clicker_play(uint8_t code, uint8_t intensity);
+        void clicker_play_at(uint8_t code, uint8_t intensity, uint16_t col, uint16_t columns);
+        void clicker_shake(void);
+    ]]) -- Already declared when this file is sourced again
+    local ok, lib = pcall(ffi.load, nvim_dir .. library)
+    if not ok or lib.clicker_init() ~= 0 then
+        vim.notify("clicker_core not usable; starting the daemon instead", vim.log.levels.WARN)
+        return nil
+    end
+    return lib
+end
+
 local function start_clicker()
     -- Get the path to your nvim config folder
     local nvim_dir = vim.fn.stdpath("config")
+    if vim.g.clack_engine == "library" then
+        clack_engine = load_clack_engine(nvim_dir)
+        if clack_engine then
+            return
+        end
+    end
     -- Path to your compiled binary
-    local clicker_path = nvim_dir .. "\\build\\clicker.exe"
+    local clicker_path = nvim_dir .. (vim.fn.has("win32") == 1 and "\\build\\clicker.exe" or "/build/clicker")
 
     -- Check if it actually exists before trying to run it
     if vim.fn.executable(clicker_path) == 1 then
         -- Start the process in the background
         -- 'detach = true' keeps it running even if Neovim reloads
         -- 'hide = true' ensures no annoying console window pops up
-        vim.fn.jobstart({ clicker_path }, {
+        -- A daemon that is already running makes this launch exit 0 at once,
+        -- as does a handoff to a rebuilt binary; only failures are worth a note
+        -- `vim.g.clack_shake_style = "overlay"` shakes a snapshot of the
+        -- terminal instead of moving the real window
+        local args = { clicker_path }
+        if vim.g.clack_shake_style then
+            vim.list_extend(args, { "--shake-style", vim.g.clack_shake_style })
+        end
+        vim.fn.jobstart(args, {
             detach = true,
             hide = true,
-            on_exit = function()
-                print("Clicker Daemon stopped.")
+            on_exit = function(_, code)
+                if code ~= 0 then
+                    print("Clicker Daemon stopped (exit " .. code .. ").")
+                end
             end
         })
     else
@@ -857,27 +897,13 @@ start_clicker()
 
 
 -- ==========================================================================
--- AUDIO BRIDGE (CRT CLACK) with DEBOUNCE
+-- AUDIO BRIDGE (CRT CLACK)
 -- ==========================================================================
-local last_clack_time = 0
-local CLACK_COOLDOWN = 40 -- ms (Adjust this: lower = faster, higher = more "stiff")
-
-local function send_clack(char)
-    local now = vim.uv.now()
-    if (now - last_clack_time) < CLACK_COOLDOWN then
-        return -- Skip this clack, we're typing too fast!
-    end
-    last_clack_time = now
-
-    local pipe_path = "\\\\.\\pipe\\nvim_clack"
-    vim.uv.fs_open(pipe_path, "w", 438, function(err, fd)
-        if not err and fd then
-            vim.uv.fs_write(fd, char, nil, function()
-                vim.uv.fs_close(fd)
-            end)
-        end
-    end)
-end
+-- lua/clack.lua owns the daemon connection; these hooks only queue codes
+-- for its once-per-tick flush.
+local clack = require("clack")
+clack.setup({ engine = clack_engine })
+local send_clack = clack.send
 
 local clack_group = vim.api.nvim_create_augroup("ClackGroup", { clear = true })
 
@@ -905,11 +931,36 @@ vim.keymap.set('i', '<BS>', function()
     return "<BS>"
 end, { expr = true })
 
--- 4. Save Sound: Sends 'e' when you save the file
+-- 4. Save Sound: Sends 'w' (an enter plus a glow burst) when you save
+vim.api.nvim_create_autocmd("BufWritePost", {
+    group = clack_group,
+    callback = function()
+        send_clack("w")
+    end,
+})
+
+-- 5. Yank and :make: their own codes, voiced by clack_events.conf
+vim.api.nvim_create_autocmd("TextYankPost", {
+    group = clack_group,
+    callback = function()
+        send_clack("y")
+    end,
+})
+
+vim.api.nvim_create_autocmd("QuickFixCmdPost", {
+    group = clack_group,
+    pattern = "make",
+    callback = function()
+        send_clack("m")
+    end,
+})
+
+-- Saving the event map reloads it in the running daemon
 vim.api.nvim_create_autocmd("BufWritePost", {
     group = clack_group,
+    pattern = "clack_events.conf",
     callback = function()
-        send_clack("e")
+        clack.control("reload")
     end,
 })
 
@@ -0,0 +1,380 @@
+-- ==========================================================================
+-- CLACK CLIENT
+-- ==========================================================================
+-- The editor's side of the daemon protocol (v1). Callers only append an
+-- event code to `pending`; a check handle notices the batch after the
+-- loop iteration and one scheduled flush samples the cursor once, frames
+-- every event and hands them to the engine, the shared ring or a single
+-- write on one long-lived pipe. Every key is sent: the daemon rate-limits
+-- and coalesces on its side.
+local M = {}
+
+local CLACK_PIPE = "\\\\.\\pipe\\nvim_clack"
+local CLACK_CONTROL_PIPE = "\\\\.\\pipe\\nvim_clack_ctl"
+if vim.fn.has("win32") == 0 then
+    -- Unix daemons listen on sockets in the per-user runtime directory
+    local runtime = (vim.env.XDG_RUNTIME_DIR or vim.env.TMPDIR or "/tmp"):gsub("/$", "")
+    CLACK_PIPE = runtime .. "/nvim_clack-" .. vim.uv.getuid() .. ".sock"
+    CLACK_CONTROL_PIPE = runtime .. "/nvim_clack_ctl-" .. vim.uv.getuid() .. ".sock"
+end
+-- Hello fields: our pid and, on Windows, the console window, so effects
+-- land on the terminal this editor runs in rather than whatever has focus
+local function clack_le(value, bytes)
+    local out = {}
+    for i = 0, bytes - 1 do
+        out[i + 1] = string.char(math.floor(value / 2 ^ (8 * i)) % 256)
+    end
+    return table.concat(out)
+end
+local CLACK_PID = vim.uv.os_getpid()
+local CLACK_WINDOW = 0
+if vim.fn.has("win32") == 1 then
+    local ffi = require("ffi")
+    pcall(ffi.cdef, "void *GetConsoleWindow(void);") -- Declared once per state
+    CLACK_WINDOW = tonumber(ffi.cast("uintptr_t", ffi.C.GetConsoleWindow()))
+end
+local CLACK_HELLO = "NCLK" .. string.char(1, 12) -- magic, version 1, 12 bytes of fields
+    .. clack_le(CLACK_PID, 4) .. clack_le(CLACK_WINDOW, 8)
+local CLACK_EVENT_LEN = 14                      -- code + timestamp + intensity + cursor cell + grid size
+local CLACK_PAN_POSITIONS = 65                  -- PAN_POSITIONS in platform.h
+local CLACK_MAX_PENDING = 64                    -- Events kept while connecting
+local CLACK_BACKOFF_MIN_MS = 100                -- First retry after a failed connect
+local CLACK_BACKOFF_MAX_MS = 5000               -- Retries never back off further than this
+
+-- Event codes waiting for this tick's flush
+local pending = {}
+
+local clack = {
+    engine = nil,   -- clicker_core when the in-process engine is loaded
+    check = nil,    -- uv_check_t that notices a non-empty `pending`
+    flush_scheduled = false,
+    pipe = nil,
+    connected = false,
+    connecting = false,
+    queue = {},     -- Frames written as soon as the connect lands
+    retry = nil,    -- uv_timer_t for the next connect attempt
+    backoff_ms = CLACK_BACKOFF_MIN_MS,
+    wanted = false, -- Events arrived (or the link dropped) while backing off
+}
+
+-- Where the cursor sits on screen (0-based cell) and the grid it sits in;
+-- the daemon pans each click across the stereo field by the column
+local function clack_position()
+    return vim.fn.screencol() - 1, vim.fn.screenrow() - 1, vim.o.columns, vim.o.lines
+end
+
+-- Same rounding as PanForColumn in clicker.c; 0 plays centred
+local function clack_pan(col, columns)
+    if columns < 2 then
+        return 0
+    end
+    local last = columns - 1
+    return 1 + math.floor((math.min(col, last) * (CLACK_PAN_POSITIONS - 1) + math.floor(last / 2)) / last)
+end
+
+-- ==========================================================================
+-- CONNECTION
+-- ==========================================================================
+local clack_connect
+
+-- Arms the next attempt and doubles the wait behind it. The timer only
+-- connects if something still wants the daemon, so an editor with no
+-- daemon and no typing does not poll for one.
+local function clack_schedule_retry()
+    clack.retry = clack.retry or vim.uv.new_timer()
+    if clack.retry:is_active() then
+        return
+    end
+    local delay = clack.backoff_ms
+    clack.backoff_ms = math.min(delay * 2, CLACK_BACKOFF_MAX_MS)
+    clack.retry:start(delay, 0, function()
+        if clack.wanted then
+            clack_connect()
+        end
+    end)
+end
+
+local function clack_disconnect()
+    if clack.pipe and not clack.pipe:is_closing() then
+        clack.pipe:close()
+    end
+    clack.pipe = nil
+    clack.connected = false
+    -- The daemon restarted or handed off: find it again without waiting
+    -- for a key, backing off in case it is gone for good
+    clack.wanted = true
+    clack_schedule_retry()
+end
+
+local function clack_write_queue()
+    if #clack.queue == 0 then
+        return
+    end
+    local pipe = clack.pipe
+    local payload = table.concat(clack.queue)
+    clack.queue = {}
+    pipe:write(payload, function(err)
+        if err and clack.pipe == pipe then
+            clack_disconnect()
+        end
+    end)
+end
+
+clack_connect = function()
+    if clack.connected or clack.connecting then
+        return
+    end
+    clack.connecting = true
+    clack.wanted = false
+
+    local pipe = vim.uv.new_pipe(false)
+    pipe:connect(CLACK_PIPE, function(err)
+        clack.connecting = false
+        if err then
+            pipe:close()
+            clack.queue = {} -- Stale by the time a retry could land
+            clack_schedule_retry()
+            return
+        end
+        clack.pipe = pipe
+        clack.connected = true
+        clack.backoff_ms = CLACK_BACKOFF_MIN_MS
+        -- The daemon never writes on this pipe; a read only ends at EOF
+        pipe:read_start(function(read_err, data)
+            if read_err or not data then
+                if clack.pipe == pipe then
+                    clack_disconnect()
+                end
+            end
+        end)
+        pipe:write(CLACK_HELLO)
+        clack_write_queue()
+    end)
+end
+
+-- One command on the control pipe; the daemon's one-line reply is dropped
+function M.control(command)
+    local pipe = vim.uv.new_pipe(false)
+    pipe:connect(CLACK_CONTROL_PIPE, function(err)
+        if err then
+            pipe:close() -- No daemon (or the in-process engine): nothing to tell
+            return
+        end
+        pipe:read_start(function()
+            pipe:close()
+        end)
+        pipe:write(command)
+    end)
+end
+
+-- ==========================================================================
+-- SHARED-MEMORY RING
+-- ==========================================================================
+-- Opt-in shared-memory ring (Windows, `vim.g.clack_ring = true` before
+-- setup runs). Once the daemon hands us a ring over the control pipe, an
+-- event is one cell write plus one store to `head`, with SetEvent only when
+-- the daemon is asleep. There is no fence between that store and reading
+-- `consumer_idle`, so a wake can be missed; the daemon's idle sleep times
+-- out to cover it. Must match the RingArea layout in platform_win32.c.
+local CLACK_RING_MAPPING = "Local\\nvim_clack_ring"
+local CLACK_RING_WAKE = "Local\\nvim_clack_ring_wake"
+local CLACK_RING_MAGIC = 0x4752434E -- "NCRG"
+local CLACK_RING_VERSION = 1
+local CLACK_RING_CAPACITY = 256
+local U32 = 4294967296
+
+local ring = {
+    ffi = nil,
+    area = nil,
+    slot = nil,
+    wake = nil,
+    claiming = false,
+    unavailable = true, -- Until setup sees the opt-in
+}
+
+local function clack_ring_open()
+    if ring.ffi then
+        return -- Mapped (or being claimed) by an earlier setup
+    end
+    ring.unavailable = vim.fn.has("win32") == 0 or not vim.g.clack_ring
+    if ring.unavailable then
+        return
+    end
+    ring.ffi = require("ffi")
+    pcall(ring.ffi.cdef, [[
+        typedef struct { uint8_t code, intensity, pan; uint32_t timestamp_ms; } clack_event;
+        typedef struct {
+            uint32_t head, owner_pid; uint8_t producer_pad[56];
+            uint32_t tail; uint8_t consumer_pad[60];
+            clack_event events[256];
+        } clack_ring;
+        typedef struct {
+            uint32_t magic, version, ring_count, capacity;
+            uint32_t consumer_idle; uint8_t header_pad[44];
+            clack_ring rings[8];
+        } clack_ring_area;
+        void *OpenFileMappingA(uint32_t access, int inherit, const char *name);
+        void *MapViewOfFile(void *mapping, uint32_t access, uint32_t offset_high,
+                            uint32_t offset_low, size_t bytes);
+        void *OpenEventA(uint32_t access, int inherit, const char *name);
+        int SetEvent(void *event);
+    ]]) -- Already declared when this module is loaded again
+end
+
+local function clack_ring_map(index)
+    local ffi = ring.ffi
+    local FILE_MAP_READ_WRITE, EVENT_MODIFY_STATE = 0x0006, 0x0002
+    -- Handles stay open for the editor's lifetime; the daemon relies on
+    -- that to find the same rings again after a --takeover
+    local mapping = ffi.C.OpenFileMappingA(FILE_MAP_READ_WRITE, 0, CLACK_RING_MAPPING)
+    local view = mapping ~= nil and ffi.C.MapViewOfFile(mapping, FILE_MAP_READ_WRITE, 0, 0, 0) or nil
+    local wake = ffi.C.OpenEventA(EVENT_MODIFY_STATE, 0, CLACK_RING_WAKE)
+    if view == nil or wake == nil then
+        ring.unavailable = true
+        return
+    end
+    local area = ffi.cast("clack_ring_area *", view)
+    if area.magic ~= CLACK_RING_MAGIC or area.version ~= CLACK_RING_VERSION
+        or area.capacity ~= CLACK_RING_CAPACITY or index >= area.ring_count then
+        ring.unavailable = true
+        return
+    end
+    ring.area, ring.slot, ring.wake = area, area.rings[index], wake
+end
+
+local function clack_ring_claim()
+    ring.claiming = true
+    local pipe = vim.uv.new_pipe(false)
+    pipe:connect(CLACK_CONTROL_PIPE, function(err)
+        if err then
+            pipe:close()
+            ring.claiming = false
+            return
+        end
+        pipe:read_start(function(read_err, data)
+            pipe:close()
+            local index = not read_err and data and tonumber(data:match("^ok (%d+)"))
+            vim.schedule(function()
+                ring.claiming = false
+                if index then
+                    clack_ring_map(index)
+                else
+                    ring.unavailable = true -- Every ring is taken; stay on the pipe
+                end
+            end)
+        end)
+        pipe:write("ring " .. CLACK_PID .. " " .. CLACK_WINDOW)
+    end)
+end
+
+-- Returns false when the event should take the pipe instead
+local function clack_ring_publish(code, pan, ts)
+    local slot = ring.slot
+    if slot == nil then
+        if not ring.unavailable and not ring.claiming and clack.connected then
+            clack_ring_claim() -- The daemon is up; this batch still takes the pipe
+        end
+        return false
+    end
+    local head = slot.head
+    if (head - slot.tail) % U32 >= CLACK_RING_CAPACITY then
+        return false -- Nobody is consuming; the pipe path notices a dead daemon
+    end
+    local cell = slot.events[head % CLACK_RING_CAPACITY]
+    cell.code = code
+    cell.intensity = 255
+    cell.pan = pan
+    cell.timestamp_ms = ts % U32
+    slot.head = (head + 1) % U32 -- The one store that publishes the event
+    return true
+end
+
+-- ==========================================================================
+-- BATCH FLUSH
+-- ==========================================================================
+-- Runs once per tick that saw events. The cursor and clock are sampled
+-- once for the whole batch: every event in it happened at the same place.
+-- The whole batch goes out, however long; coalescing and shedding are the
+-- daemon's, which counts them in its stats.
+local function clack_flush()
+    clack.flush_scheduled = false
+    local count = #pending
+    if count == 0 then
+        return
+    end
+    local batch = pending
+    pending = {}
+
+    local col, row, columns, lines = clack_position()
+    if clack.engine then
+        for i = 1, count do
+            clack.engine.clicker_play_at(batch[i]:byte(), 255, col, columns)
+        end
+        return
+    end
+
+    local ts = vim.uv.now()
+    local first = 1
+    if ring.slot or not ring.unavailable then
+        local pan = clack_pan(col, columns)
+        while first <= count and clack_ring_publish(batch[first]:byte(), pan, ts) do
+            first = first + 1
+        end
+        if first > 1 and ring.area.consumer_idle ~= 0 then
+            ring.ffi.C.SetEvent(ring.wake) -- One wake for the whole batch
+        end
+        if first > count then
+            return
+        end
+    end
+
+    if not clack.connected and not clack.connecting then
+        if clack.retry and clack.retry:is_active() then
+            clack.wanted = true -- Backing off; these clacks would arrive stale
+            return
+        end
+        clack_connect()
+    end
+    local tail = clack_le(ts % U32, 4) .. string.char(255)
+        .. clack_le(col, 2) .. clack_le(row, 2) .. clack_le(columns, 2) .. clack_le(lines, 2)
+    for i = first, count do
+        if not clack.connected and #clack.queue >= CLACK_MAX_PENDING then
+            break -- Only the offline backlog is capped
+        end
+        clack.queue[#clack.queue + 1] = string.char(CLACK_EVENT_LEN, batch[i]:byte()) .. tail
+    end
+    if clack.connected then
+        clack_write_queue()
+    end
+end
+
+-- ==========================================================================
+-- PUBLIC API
+-- ==========================================================================
+-- Queues one event code for this tick's flush: the only work done on
+-- the typing path
+function M.send(char)
+    pending[#pending + 1] = char
+end
+
+-- Starts the per-tick flush. `opts.engine` is a loaded clicker_core that
+-- plays events in-process instead of the daemon. Safe to call again when
+-- init.lua is sourced twice; the connection is kept.
+function M.setup(opts)
+    clack.engine = opts and opts.engine or nil
+    clack_ring_open()
+    if clack.check then
+        return
+    end
+    -- Check callbacks are fast events, where vim.fn is off limits, so the
+    -- flush itself goes through vim.schedule
+    clack.check = vim.uv.new_check()
+    clack.check:start(function()
+        if #pending > 0 and not clack.flush_scheduled then
+            clack.flush_scheduled = true
+            vim.schedule(clack_flush)
+        end
+    end)
+end
+
+return M
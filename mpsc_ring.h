@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================
+// LOCK-FREE RING (Bounded MPSC, sequence-numbered cells)
+// ============================================================
+// Any number of threads push, exactly one pops. Push never blocks: a full
+// ring returns false and the caller decides what a drop means. Capacity
+// must be a power of two.
+#define DEFINE_MPSC_RING(Name, Type, Capacity)                                 \
+  typedef struct {                                                             \
+    atomic_size_t sequence;                                                    \
+    Type value;                                                                \
+  } Name##Cell;                                                                \
+                                                                               \
+  typedef struct {                                                             \
+    Name##Cell cells[Capacity];                                                \
+    alignas(64) atomic_size_t enqueue_pos;                                     \
+    alignas(64) size_t dequeue_pos; /* Consumer only */                        \
+  } Name;                                                                      \
+                                                                               \
+  static void Name##Init(Name *ring) {                                         \
+    for (size_t i = 0; i < (Capacity); i++) {                                  \
+      atomic_init(&ring->cells[i].sequence, i);                                \
+    }                                                                          \
+    atomic_init(&ring->enqueue_pos, 0);                                        \
+    ring->dequeue_pos = 0;                                                     \
+  }                                                                            \
+                                                                               \
+  static bool Name##Push(Name *ring, Type value) {                             \
+    size_t pos =                                                               \
+        atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);        \
+    while (true) {                                                             \
+      Name##Cell *cell = &ring->cells[pos & ((Capacity) - 1)];                 \
+      const size_t sequence =                                                  \
+          atomic_load_explicit(&cell->sequence, memory_order_acquire);         \
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;                \
+      if (diff == 0) {                                                         \
+        if (atomic_compare_exchange_weak_explicit(                             \
+                &ring->enqueue_pos, &pos, pos + 1, memory_order_relaxed,       \
+                memory_order_relaxed)) {                                       \
+          cell->value = value;                                                 \
+          atomic_store_explicit(&cell->sequence, pos + 1,                      \
+                                memory_order_release);                         \
+          return true;                                                         \
+        }                                                                      \
+      } else if (diff < 0) {                                                   \
+        return false;                                                          \
+      } else {                                                                 \
+        pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);  \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  [[nodiscard]]                                                                \
+  static bool Name##Pop(Name *ring, Type *out) {                               \
+    Name##Cell *cell = &ring->cells[ring->dequeue_pos & ((Capacity) - 1)];     \
+    const size_t sequence =                                                    \
+        atomic_load_explicit(&cell->sequence, memory_order_acquire);           \
+    if ((intptr_t)sequence - (intptr_t)(ring->dequeue_pos + 1) < 0)            \
+      return false;                                                            \
+    *out = cell->value;                                                        \
+    atomic_store_explicit(&cell->sequence, ring->dequeue_pos + (Capacity),     \
+                          memory_order_release);                               \
+    ring->dequeue_pos++;                                                       \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  /* Consumer only: whether Pop would succeed right now */                     \
+  [[maybe_unused, nodiscard]]                                                  \
+  static bool Name##Pending(Name *ring) {                                      \
+    const Name##Cell *cell =                                                   \
+        &ring->cells[ring->dequeue_pos & ((Capacity) - 1)];                    \
+    const size_t sequence =                                                    \
+        atomic_load_explicit(&cell->sequence, memory_order_acquire);           \
+    return (intptr_t)sequence - (intptr_t)(ring->dequeue_pos + 1) >= 0;        \
+  }                                                                            \
+                                                                               \
+  /* Consumer only: cells pushed, or being pushed, and not yet popped */       \
+  [[maybe_unused, nodiscard]]                                                  \
+  static size_t Name##Depth(Name *ring) {                                      \
+    return atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed) -    \
+           ring->dequeue_pos;                                                  \
+  }
@@ -0,0 +1,255 @@
+#pragma once
+
+// The seam between the portable core (clicker.c) and exactly one backend:
+//   platform_win32.c   named pipes on IOCP, WASAPI, window shake
+//   platform_linux.c   AF_UNIX on epoll, ALSA (PipeWire via its ALSA node)
+//   platform_macos.c   AF_UNIX on kqueue, CoreAudio output unit
+// The core owns the wire protocol, rate limiting, the mixer and the stats.
+// A backend owns the transport, the audio device and window effects, and
+// only ever talks to the core through the functions declared here.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================
+// SHARED CONSTANTS
+// ============================================================
+static constexpr uint32_t READ_BUFFER_SIZE = 1024;
+static constexpr int PIPE_POOL_SIZE = 16; // Default concurrent editors
+static constexpr int MAX_POOL_CLIENTS = 256; // --clients ceiling
+static constexpr int MAX_PIPE_WORKERS = 64;
+static constexpr int MIX_CHANNELS = 2;    // The mix is interleaved stereo
+static constexpr uint32_t CONTROL_COMMAND_MAX = 256;
+static constexpr uint32_t AUDIO_REOPEN_DELAY_MS = 1000;
+
+// ============================================================
+// CLIENT SESSION (Embedded in each backend's connection state)
+// ============================================================
+// Events are batched and rate-limited per lane: one per sound-bank slot
+// plus a silent lane for effect-only events (the core's event table).
+static constexpr int EVENT_LANE_COUNT = 4;
+
+typedef struct {
+  float tokens;
+  int64_t last_refill; // Clock ticks
+  int64_t window_end;  // Clock ticks; events before this merge
+} LaneLimiter;
+
+typedef struct {
+  LaneLimiter lanes[EVENT_LANE_COUNT];
+} RateLimiter;
+
+typedef enum {
+  PROTOCOL_UNKNOWN, // Nothing (or only part of the magic) seen yet
+  PROTOCOL_LEGACY,
+  PROTOCOL_FRAMED,
+} ProtocolMode;
+
+// Stereo position of an event: PAN_NONE plays centred, 1 is hard left
+// and PAN_POSITIONS hard right. Ring clients compute it themselves as
+// 1 + round(col * (PAN_POSITIONS - 1) / (columns - 1)).
+static constexpr uint8_t PAN_NONE = 0;
+static constexpr int PAN_POSITIONS = 65;
+
+// One decoded event. Also the cell layout of the shared-memory rings, so
+// keep it at 8 bytes with these offsets.
+typedef struct {
+  uint8_t code;
+  uint8_t intensity;
+  uint8_t pan;           // Was padding, so older ring clients leave it 0
+  uint32_t timestamp_ms; // Client clock; only meaningful per connection
+} ClackEvent;
+
+// Who a window effect is for, from the client's hello. The window is the
+// client's console (or its own top-level window); zeroes mean unknown and
+// the backend falls back to the foreground terminal.
+typedef struct {
+  uint32_t pid;
+  uint64_t window; // HWND on Windows
+} EffectTarget;
+
+// Backends read into `buffer + buffered` (at most READ_BUFFER_SIZE -
+// buffered bytes) and hand the count to SessionReceive.
+typedef struct {
+  ProtocolMode protocol;
+  RateLimiter limiter;
+  EffectTarget target;
+  int queue;         // Core's trigger queue while open
+  uint8_t trace_id;  // Tags this client's --record events; wraps at 256
+  uint32_t buffered; // Bytes of an incomplete frame kept at the buffer front
+  uint8_t buffer[READ_BUFFER_SIZE];
+} ClientSession;
+
+// ============================================================
+// DAEMON CONFIGURATION (Parsed by the core, read by backends)
+// ============================================================
+typedef struct {
+  bool exclusive;
+  double period_ms;
+  uint32_t park_after_ms; // Silence before the stream is released; 0 never
+} AudioConfig;
+
+typedef enum {
+  SHAKE_STYLE_MOVE,    // Moves the terminal's real frame
+  SHAKE_STYLE_OVERLAY, // Shakes a snapshot; the real window stays put
+} ShakeStyle;
+
+typedef struct {
+  int duration_ms;
+  int amplitude_px;
+  ShakeStyle style;
+} ShakeConfig;
+
+// Pool sizes, fixed for the process lifetime (--voices, --clients)
+typedef struct {
+  int voices;
+  int clients; // Sessions each backend pools for editors
+} PoolConfig;
+
+// Windows only so far; the other backends leave this to the OS
+typedef struct {
+  bool mmcss;        // Audio and event threads join MMCSS "Pro Audio"
+  bool allow_ecoqos; // Let the OS throttle the daemon as a background task
+  uint64_t affinity; // CPU mask for those threads; 0 keeps every CPU
+} SchedulingConfig;
+
+typedef enum {
+  CONTROL_CONTINUE,
+  CONTROL_EXIT, // Reply sent; this process should go away now
+} ControlAction;
+
+extern AudioConfig audio_config;
+extern ShakeConfig shake_config;
+extern SchedulingConfig scheduling_config;
+extern PoolConfig pool_config;
+extern bool takeover_requested; // --takeover
+
+// ============================================================
+// CORE SERVICES (clicker.c; callable from any backend thread)
+// ============================================================
+[[gnu::format(printf, 1, 2)]]
+void DaemonLog(const char *format, ...);
+
+// Transport side. Open/Closed bracket one client; Receive decodes and
+// dispatches `bytes` fresh bytes and returns false when the client sent
+// something malformed and should be dropped (already counted as closed).
+void SessionOpen(ClientSession *session);
+[[nodiscard]]
+bool SessionReceive(ClientSession *session, uint32_t bytes,
+                    int64_t read_ticks);
+void SessionClosed(ClientSession *session);
+// Same as Receive for transports that carry decoded events (the rings)
+void SessionDeliver(ClientSession *session, const ClackEvent *events,
+                    uint32_t count, int64_t read_ticks);
+
+// Control/stats endpoints. The reply is one line in `reply`.
+[[nodiscard]]
+ControlAction HandleControlCommand(const char *command, char *reply,
+                                   size_t capacity);
+[[nodiscard]]
+int FormatStatsJson(char *out, size_t capacity);
+
+// Not thread-safe; backends with several transport threads serialize it
+void ReloadSoundBank(bool force);
+
+// Startup memory. Backends take their session pools (pool_config.clients
+// of platform_session_bytes each) from here and seal it before serving;
+// from then on every request fails. Zeroed, 64-byte aligned, never freed.
+[[nodiscard]]
+void *ArenaAlloc(size_t bytes);
+void ArenaSeal(void);
+
+// CLICKER_TRAP_HEAP builds: true while this thread decodes, dispatches or
+// renders, when the backend's allocator hook traps. Pause/Resume bracket
+// one-time starts reached from there. No-ops in other builds.
+[[nodiscard]]
+bool OnHotPath(void);
+[[nodiscard]]
+int PauseHotPath(void);
+void ResumeHotPath(int depth);
+
+// Render side, audio thread only. Each device period is Begin (adopt new
+// sounds, apply queued triggers), Mix, then End once the device owns the
+// samples. MixVoices returns false when it produced silence.
+void BeginAudioPeriod(uint32_t device_rate);
+[[nodiscard]]
+bool MixVoices(float *mix, uint32_t frames);
+void EndAudioPeriod(void);
+void DiscardQueuedTriggers(void); // Stale after a device reopen
+void SilenceVoices(void);
+
+// Idle parking, for backends whose render thread can close its stream.
+// After a period, AudioWantsPark says --park-after has passed in silence;
+// the backend closes the device and calls ParkAudio, which returns false
+// when a trigger raced in. Otherwise it sleeps until PlatformWakeAudio and
+// calls UnparkAudio once the device is open again, before the first period.
+[[nodiscard]]
+bool AudioWantsPark(void);
+[[nodiscard]]
+bool ParkAudio(void);
+void UnparkAudio(void);
+
+// Daemon only: maps the intensity bus (typing rate and bursts for visual
+// effects) and starts its publisher. Call once this process owns the
+// single instance, after signal masks are set.
+void StartIntensityBus(void);
+
+[[nodiscard]]
+static inline float ClampSample(float sample) {
+  return sample > 1.0f ? 1.0f : (sample < -1.0f ? -1.0f : sample);
+}
+
+// ============================================================
+// BACKEND INTERFACE (Implemented once per platform)
+// ============================================================
+// One pooled session's transport state, ClientSession included; sizes
+// the engine arena
+extern const size_t platform_session_bytes;
+
+[[nodiscard]]
+int64_t PlatformClockRate(void); // Ticks per second of PlatformNowTicks
+[[nodiscard]]
+int64_t PlatformNowTicks(void);
+[[nodiscard]]
+bool PlatformHasOutputStream(void);
+[[nodiscard]]
+unsigned long PlatformProcessId(void);
+void PlatformYield(void);
+void PlatformSleep(uint32_t ms);
+// A detached thread running `body` for the rest of the process lifetime
+[[nodiscard]]
+bool PlatformStartThread(void (*body)(void));
+
+// WAV overrides. The stamp changes whenever the file does; 0 never occurs
+// for an existing file. Reads return a malloc'd image or nullptr.
+[[nodiscard]]
+bool PlatformFileStamp(const char *path, uint64_t *stamp);
+[[nodiscard]]
+uint8_t *PlatformReadFile(const char *path, uint32_t max_bytes,
+                          uint32_t *size);
+
+void PlatformStartAudio(void);    // Once, on the first event that needs it
+void PlatformWakeAudio(void);     // After ParkAudio; never blocks
+void PlatformRequestReload(void); // Reload the sound bank off this thread
+// Window effects. Never block the caller.
+void PlatformShake(const EffectTarget *target);
+void PlatformFlash(const EffectTarget *target); // One blink of the caption
+// This process's own terminal window (library mode), 0 when unknown
+[[nodiscard]]
+uint64_t PlatformConsoleWindow(void);
+// Named shared memory other processes can map read-only, `bytes` long and
+// zeroed when new; nullptr if it can't be created. Never unmapped.
+[[nodiscard]]
+void *PlatformMapBus(size_t bytes);
+// Shared-memory ring for process `owner->pid`: its index, or -1 if none is
+// free (or the backend has no ring transport)
+[[nodiscard]]
+int PlatformClaimRing(const EffectTarget *owner);
+
+// Single instance, transport and event loop. Returns only to exit.
+[[nodiscard]]
+int PlatformRunDaemon(void);
+// Library mode instead: whatever PlatformStartAudio and PlatformShake rely
+// on from the daemon's loop (sound reloads, the sounds/ watch), no transport
+[[nodiscard]]
+bool PlatformStartEmbedded(void);
@@ -0,0 +1,342 @@
+// Linux backend: epoll readiness for the shared POSIX server, inotify for
+// sounds/, signalfd for shutdown, and an ALSA render thread. ALSA's
+// "default" PCM is PipeWire's (or PulseAudio's) ALSA node on a desktop.
+#define _DEFAULT_SOURCE
+
+#include "platform.h"
+#include "platform_posix.h"
+
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================================
+// CONSTANTS & MACROS
+// ============================================================
+static constexpr size_t DRAIN_BUFFER_BYTES = 4096; // inotify + signalfd
+static constexpr unsigned AUDIO_PREFERRED_RATE = 48000;
+static constexpr unsigned AUDIO_PERIODS = 2; // One playing, one being mixed
+static constexpr int AUDIO_EVENT_TIMEOUT_MS = 2000;
+static constexpr int AUDIO_FIFO_PRIORITY = 10; // Below PipeWire's own threads
+static constexpr int AUDIO_IDLE = 1; // Not an ALSA error: park until an event
+
+// The sound server owns the card and follows the user's output choice;
+// --exclusive opens the first card directly, bypassing it.
+static const char *const SHARED_DEVICE = "default";
+static const char *const EXCLUSIVE_DEVICE = "plughw:0,0";
+
+// ============================================================
+// HEAP TRAP (CLICKER_TRAP_HEAP daemon builds)
+// ============================================================
+// The executable preempts glibc's allocator for the whole process, ALSA
+// and libc included; the real entry points stay reachable as __libc_*.
+// Not in clicker_core, where reaching our TLS can itself allocate.
+#if defined(CLICKER_TRAP_HEAP) && !defined(CLICKER_LIBRARY)
+extern void *__libc_malloc(size_t bytes);
+extern void *__libc_calloc(size_t count, size_t bytes);
+extern void *__libc_realloc(void *block, size_t bytes);
+
+void *malloc(size_t bytes) {
+  if (OnHotPath()) {
+    __builtin_trap();
+  }
+  return __libc_malloc(bytes);
+}
+
+void *calloc(size_t count, size_t bytes) {
+  if (OnHotPath()) {
+    __builtin_trap();
+  }
+  return __libc_calloc(count, bytes);
+}
+
+void *realloc(void *block, size_t bytes) {
+  if (OnHotPath()) {
+    __builtin_trap();
+  }
+  return __libc_realloc(block, bytes);
+}
+#endif
+
+// ============================================================
+// READINESS POLLER (epoll)
+// ============================================================
+static int epoll_fd = -1;
+
+bool PollerOpen(void) {
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  return epoll_fd >= 0;
+}
+
+bool PollerAdd(PollSource *source) {
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = source};
+  return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, source->fd, &event) == 0;
+}
+
+void PollerRemove(PollSource *source) {
+  (void)epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source->fd, nullptr);
+}
+
+int PollerWait(PollSource *ready[POLLER_BATCH]) {
+  struct epoll_event events[POLLER_BATCH];
+  const int count = epoll_wait(epoll_fd, events, POLLER_BATCH, -1);
+  if (count < 0)
+    return errno == EINTR ? 0 : -1;
+  for (int i = 0; i < count; i++) {
+    ready[i] = events[i].data.ptr;
+  }
+  return count;
+}
+
+// Editors save by writing in place or by renaming a temp file over the
+// original; both end in one of these two events.
+bool PollerWatchDirectory(PollSource *source, const char *path) {
+  const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+    return false;
+  *source = (PollSource){.kind = SOURCE_SOUNDS, .fd = fd};
+  if (inotify_add_watch(fd, path, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+      !PollerAdd(source)) {
+    close(fd);
+    source->fd = -1;
+    return false;
+  }
+  return true;
+}
+
+bool PollerWatchSignals(PollSource *source) {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGHUP);
+  // Inherited by every thread created later, so only the signalfd sees them
+  if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0)
+    return false;
+
+  const int fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd < 0)
+    return false;
+  *source = (PollSource){.kind = SOURCE_SIGNAL, .fd = fd};
+  return PollerAdd(source);
+}
+
+void PollerDrain(PollSource *source) {
+  alignas(struct inotify_event) uint8_t records[DRAIN_BUFFER_BYTES];
+  while (read(source->fd, records, sizeof(records)) > 0) {
+  }
+}
+
+// ============================================================
+// AUDIO ENGINE (ALSA render thread)
+// ============================================================
+typedef struct {
+  snd_pcm_t *pcm;
+  const char *name;
+  unsigned sample_rate;
+  snd_pcm_uframes_t period_frames;
+  float *mix; // MIX_CHANNELS interleaved, period_frames long
+} AudioDevice;
+
+static sem_t audio_wake; // Posted by PlatformWakeAudio
+
+static void CloseAudioDevice(AudioDevice *device) {
+  if (device->pcm != nullptr) {
+    snd_pcm_close(device->pcm);
+  }
+  free(device->mix);
+  *device = (AudioDevice){0};
+}
+
+// Float stereo straight from the mixer; plug/PipeWire converts if the
+// hardware wants something else. Returns 0 or a negative ALSA error.
+[[nodiscard]]
+static int OpenAudioDevice(AudioDevice *device) {
+  device->name = audio_config.exclusive ? EXCLUSIVE_DEVICE : SHARED_DEVICE;
+  int err = snd_pcm_open(&device->pcm, device->name, SND_PCM_STREAM_PLAYBACK,
+                         0);
+  if (err < 0)
+    return err;
+
+  snd_pcm_hw_params_t *hw = nullptr;
+  snd_pcm_sw_params_t *sw = nullptr;
+  unsigned rate = AUDIO_PREFERRED_RATE;
+  snd_pcm_uframes_t period = 0;
+  snd_pcm_uframes_t buffer = 0;
+
+  err = snd_pcm_hw_params_malloc(&hw);
+  if (err >= 0)
+    err = snd_pcm_hw_params_any(device->pcm, hw);
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_access(device->pcm, hw,
+                                       SND_PCM_ACCESS_RW_INTERLEAVED);
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_format(device->pcm, hw, SND_PCM_FORMAT_FLOAT);
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_channels(device->pcm, hw, MIX_CHANNELS);
+  if (err >= 0)
+    err = snd_pcm_hw_params_set_rate_near(device->pcm, hw, &rate, nullptr);
+  if (err >= 0) {
+    period = (snd_pcm_uframes_t)(audio_config.period_ms * rate / 1000.0);
+    err = snd_pcm_hw_params_set_period_size_near(device->pcm, hw, &period,
+                                                 nullptr);
+  }
+  if (err >= 0) {
+    buffer = period * AUDIO_PERIODS;
+    err = snd_pcm_hw_params_set_buffer_size_near(device->pcm, hw, &buffer);
+  }
+  if (err >= 0)
+    err = snd_pcm_hw_params(device->pcm, hw);
+  snd_pcm_hw_params_free(hw);
+
+  // Start on the first period and wake us for every one after it
+  if (err >= 0)
+    err = snd_pcm_sw_params_malloc(&sw);
+  if (err >= 0)
+    err = snd_pcm_sw_params_current(device->pcm, sw);
+  if (err >= 0)
+    err = snd_pcm_sw_params_set_start_threshold(device->pcm, sw, period);
+  if (err >= 0)
+    err = snd_pcm_sw_params_set_avail_min(device->pcm, sw, period);
+  if (err >= 0)
+    err = snd_pcm_sw_params(device->pcm, sw);
+  snd_pcm_sw_params_free(sw);
+
+  if (err >= 0) {
+    device->sample_rate = rate;
+    device->period_frames = period;
+    device->mix = malloc(sizeof(float) * MIX_CHANNELS * period);
+    if (device->mix == nullptr)
+      err = -ENOMEM;
+  }
+  if (err < 0) {
+    CloseAudioDevice(device);
+  }
+  return err;
+}
+
+// Wait for a period of room, then mix into it, so triggers get applied as
+// late as possible. Returns the error that ended the stream, or AUDIO_IDLE
+// once nothing has played for --park-after.
+[[nodiscard]]
+static int RunAudioDevice(AudioDevice *device) {
+  const uint32_t frames = (uint32_t)device->period_frames;
+  while (true) {
+    const int ready = snd_pcm_wait(device->pcm, AUDIO_EVENT_TIMEOUT_MS);
+    if (ready == 0)
+      return -EIO; // The device stopped asking for audio
+    if (ready < 0) {
+      // Underruns (-EPIPE) and suspends (-ESTRPIPE) are recoverable
+      const int err = snd_pcm_recover(device->pcm, ready, 1);
+      if (err < 0)
+        return err;
+      continue;
+    }
+
+    BeginAudioPeriod(device->sample_rate);
+    if (MixVoices(device->mix, frames)) {
+      for (uint32_t i = 0; i < frames * MIX_CHANNELS; i++) {
+        device->mix[i] = ClampSample(device->mix[i]);
+      }
+    }
+    const snd_pcm_sframes_t written =
+        snd_pcm_writei(device->pcm, device->mix, frames);
+    const int err =
+        written < 0 ? snd_pcm_recover(device->pcm, (int)written, 1) : 0;
+    EndAudioPeriod(); // Before any return: it leaves the hot path
+    if (err < 0)
+      return err;
+    if (AudioWantsPark())
+      return AUDIO_IDLE;
+  }
+}
+
+// With the PCM closed the sound server can suspend the sink
+static void ParkRenderThread(void) {
+  if (!ParkAudio())
+    return; // A trigger raced the park; reopen for it right away
+
+  DaemonLog("Audio: silent for %u s; stream released until the next event\n",
+            (unsigned)(audio_config.park_after_ms / 1000));
+  while (sem_wait(&audio_wake) != 0 && errno == EINTR) {
+  }
+}
+
+void PlatformWakeAudio(void) {
+  sem_post(&audio_wake);
+}
+
+// ALSA has no endpoint notifications. Through a sound server the default
+// PCM already follows the user's output choice, so reopening only happens
+// when the server or the card goes away.
+static void *AudioRenderThread([[maybe_unused]] void *parameter) {
+  AudioDevice device = {0};
+  bool reopening = false;
+  bool waking = false; // Back from a park: queued triggers are fresh
+  while (true) {
+    int err = OpenAudioDevice(&device);
+    if (err >= 0) {
+      DaemonLog("Audio: ALSA \"%s\", %u Hz, %lu-frame period (%.2f ms)\n",
+                device.name, device.sample_rate,
+                (unsigned long)device.period_frames,
+                1000.0 * (double)device.period_frames / device.sample_rate);
+      if (waking) {
+        UnparkAudio();
+      } else if (reopening) {
+        DiscardQueuedTriggers();
+      }
+      waking = false;
+      err = RunAudioDevice(&device);
+      CloseAudioDevice(&device);
+      SilenceVoices();
+    }
+    reopening = true;
+    if (err == AUDIO_IDLE) {
+      ParkRenderThread();
+      waking = true;
+      continue;
+    }
+    DaemonLog("Audio device unavailable (%s). Retrying in %u ms\n",
+              snd_strerror(err), AUDIO_REOPEN_DELAY_MS);
+    const struct timespec delay = {
+        .tv_sec = AUDIO_REOPEN_DELAY_MS / 1000,
+        .tv_nsec = (long)(AUDIO_REOPEN_DELAY_MS % 1000) * 1000000L,
+    };
+    nanosleep(&delay, nullptr);
+  }
+  return nullptr;
+}
+
+// SCHED_FIFO needs rtkit limits or CAP_SYS_NICE; without them the render
+// thread runs at normal priority rather than not at all.
+void StartAudioOutput(void) {
+  pthread_attr_t attributes;
+  const struct sched_param priority = {.sched_priority = AUDIO_FIFO_PRIORITY};
+  if (sem_init(&audio_wake, 0, 0) != 0) {
+    DaemonLog("Could not start audio thread\n");
+    return;
+  }
+  pthread_attr_init(&attributes);
+  pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+  pthread_attr_setschedparam(&attributes, &priority);
+
+  pthread_t thread;
+  if (pthread_create(&thread, &attributes, AudioRenderThread, nullptr) == 0 ||
+      pthread_create(&thread, nullptr, AudioRenderThread, nullptr) == 0) {
+    pthread_detach(thread); // Lives for the whole daemon lifetime
+  } else {
+    DaemonLog("Could not start audio thread\n");
+  }
+  pthread_attr_destroy(&attributes);
+}
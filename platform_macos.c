@@ -0,0 +1,230 @@
+// macOS backend: kqueue readiness for the shared POSIX server (sockets,
+// the sounds/ vnode and shutdown signals) and a CoreAudio output unit
+// whose render callback pulls straight from the mixer.
+#define _DARWIN_C_SOURCE
+
+#include "platform.h"
+#include "platform_posix.h"
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <CoreAudio/CoreAudio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/event.h>
+#include <unistd.h>
+
+// ============================================================
+// CONSTANTS & MACROS
+// ============================================================
+static constexpr double AUDIO_FALLBACK_RATE = 48000.0;
+
+// ============================================================
+// READINESS POLLER (kqueue)
+// ============================================================
+static int kqueue_fd = -1;
+
+bool PollerOpen(void) {
+  kqueue_fd = kqueue();
+  return kqueue_fd >= 0 && fcntl(kqueue_fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+bool PollerAdd(PollSource *source) {
+  struct kevent change;
+  EV_SET(&change, source->fd, EVFILT_READ, EV_ADD, 0, 0, source);
+  return kevent(kqueue_fd, &change, 1, nullptr, 0, nullptr) == 0;
+}
+
+void PollerRemove(PollSource *source) {
+  struct kevent change;
+  EV_SET(&change, source->fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+  (void)kevent(kqueue_fd, &change, 1, nullptr, 0, nullptr);
+}
+
+int PollerWait(PollSource *ready[POLLER_BATCH]) {
+  struct kevent events[POLLER_BATCH];
+  const int count =
+      kevent(kqueue_fd, nullptr, 0, events, POLLER_BATCH, nullptr);
+  if (count < 0)
+    return errno == EINTR ? 0 : -1;
+  for (int i = 0; i < count; i++) {
+    ready[i] = events[i].udata;
+  }
+  return count;
+}
+
+// A directory vnode reports entries being added, removed or renamed,
+// which covers editors that save through a temp file. In-place rewrites
+// don't touch the directory; the control "reload" picks those up.
+bool PollerWatchDirectory(PollSource *source, const char *path) {
+  const int fd = open(path, O_EVTONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  *source = (PollSource){.kind = SOURCE_SOUNDS, .fd = fd};
+
+  struct kevent change;
+  EV_SET(&change, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+         NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB, 0, source);
+  if (kevent(kqueue_fd, &change, 1, nullptr, 0, nullptr) != 0) {
+    close(fd);
+    source->fd = -1;
+    return false;
+  }
+  return true;
+}
+
+// kqueue still reports signals whose disposition is SIG_IGN, and ignoring
+// them keeps the default action from killing us first.
+bool PollerWatchSignals(PollSource *source) {
+  static const int SHUTDOWN_SIGNALS[] = {SIGINT, SIGTERM, SIGHUP};
+  static constexpr int SIGNAL_COUNT =
+      sizeof(SHUTDOWN_SIGNALS) / sizeof(SHUTDOWN_SIGNALS[0]);
+  *source = (PollSource){.kind = SOURCE_SIGNAL, .fd = -1};
+
+  struct kevent changes[SIGNAL_COUNT];
+  for (int i = 0; i < SIGNAL_COUNT; i++) {
+    signal(SHUTDOWN_SIGNALS[i], SIG_IGN);
+    EV_SET(&changes[i], SHUTDOWN_SIGNALS[i], EVFILT_SIGNAL, EV_ADD, 0, 0,
+           source);
+  }
+  return kevent(kqueue_fd, changes, SIGNAL_COUNT, nullptr, 0, nullptr) == 0;
+}
+
+// kqueue events carry no records to read back
+void PollerDrain([[maybe_unused]] PollSource *source) {}
+
+// ============================================================
+// AUDIO ENGINE (CoreAudio default output unit)
+// ============================================================
+static AudioUnit output_unit = nullptr;
+static uint32_t output_rate = 0; // Rate of the format we hand the unit
+
+// Runs on CoreAudio's real-time I/O thread, once per device buffer
+static OSStatus RenderOutput([[maybe_unused]] void *context,
+                             AudioUnitRenderActionFlags *flags,
+                             [[maybe_unused]] const AudioTimeStamp *timestamp,
+                             [[maybe_unused]] UInt32 bus, UInt32 frames,
+                             AudioBufferList *buffers) {
+  float *mix = buffers->mBuffers[0].mData;
+  BeginAudioPeriod(output_rate);
+  if (MixVoices(mix, frames)) {
+    for (UInt32 i = 0; i < frames * MIX_CHANNELS; i++) {
+      mix[i] = ClampSample(mix[i]);
+    }
+  } else {
+    *flags |= kAudioUnitRenderAction_OutputIsSilence;
+  }
+  EndAudioPeriod();
+  return noErr;
+}
+
+[[nodiscard]]
+static AudioObjectID DefaultOutputDevice(void) {
+  const AudioObjectPropertyAddress address = {
+      kAudioHardwarePropertyDefaultOutputDevice,
+      kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+  AudioObjectID device = kAudioObjectUnknown;
+  UInt32 size = sizeof(device);
+  if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0,
+                                 nullptr, &size, &device) != noErr)
+    return kAudioObjectUnknown;
+  return device;
+}
+
+[[nodiscard]]
+static double NominalSampleRate(AudioObjectID device) {
+  const AudioObjectPropertyAddress address = {
+      kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal,
+      kAudioObjectPropertyElementMain};
+  Float64 rate = 0.0;
+  UInt32 size = sizeof(rate);
+  if (AudioObjectGetPropertyData(device, &address, 0, nullptr, &size,
+                                 &rate) != noErr ||
+      rate <= 0.0)
+    return AUDIO_FALLBACK_RATE;
+  return rate;
+}
+
+// The HAL defaults to 512 frames (~11 ms at 48 kHz); ask for our period.
+// The device clamps the request to the range it supports.
+static void RequestBufferFrames(AudioObjectID device, UInt32 frames) {
+  const AudioObjectPropertyAddress address = {
+      kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal,
+      kAudioObjectPropertyElementMain};
+  (void)AudioObjectSetPropertyData(device, &address, 0, nullptr,
+                                   sizeof(frames), &frames);
+}
+
+// Hog mode is CoreAudio's exclusive access: no other process can play
+static void RequestHogMode(AudioObjectID device) {
+  const AudioObjectPropertyAddress address = {
+      kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal,
+      kAudioObjectPropertyElementMain};
+  pid_t owner = getpid();
+  (void)AudioObjectSetPropertyData(device, &address, 0, nullptr,
+                                   sizeof(owner), &owner);
+}
+
+// The render callback never asks to park, so the unit stays started for
+// the daemon's lifetime and there is nothing to wake
+void PlatformWakeAudio(void) {}
+
+// The default output unit follows the user's device choice on its own,
+// converting from our format as needed, so there is no reopen loop here.
+void StartAudioOutput(void) {
+  const AudioComponentDescription description = {
+      .componentType = kAudioUnitType_Output,
+      .componentSubType = kAudioUnitSubType_DefaultOutput,
+      .componentManufacturer = kAudioUnitManufacturer_Apple,
+  };
+  const AudioObjectID device = DefaultOutputDevice();
+  output_rate = (uint32_t)NominalSampleRate(device);
+  const UInt32 period_frames =
+      (UInt32)(audio_config.period_ms * output_rate / 1000.0);
+
+  const AudioStreamBasicDescription format = {
+      .mSampleRate = output_rate,
+      .mFormatID = kAudioFormatLinearPCM,
+      .mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked,
+      .mBytesPerPacket = sizeof(float) * MIX_CHANNELS,
+      .mFramesPerPacket = 1,
+      .mBytesPerFrame = sizeof(float) * MIX_CHANNELS,
+      .mChannelsPerFrame = MIX_CHANNELS,
+      .mBitsPerChannel = 32,
+  };
+  const AURenderCallbackStruct callback = {.inputProc = RenderOutput};
+
+  AudioComponent component = AudioComponentFindNext(nullptr, &description);
+  OSStatus status = component != nullptr
+                        ? AudioComponentInstanceNew(component, &output_unit)
+                        : kAudioUnitErr_NoConnection;
+  if (status == noErr)
+    status = AudioUnitSetProperty(output_unit, kAudioUnitProperty_StreamFormat,
+                                  kAudioUnitScope_Input, 0, &format,
+                                  sizeof(format));
+  if (status == noErr)
+    status = AudioUnitSetProperty(
+        output_unit, kAudioUnitProperty_SetRenderCallback,
+        kAudioUnitScope_Input, 0, &callback, sizeof(callback));
+  if (status == noErr) {
+    if (device != kAudioObjectUnknown) {
+      if (audio_config.exclusive) {
+        RequestHogMode(device);
+      }
+      RequestBufferFrames(device, period_frames);
+    }
+    status = AudioUnitInitialize(output_unit);
+  }
+  if (status == noErr)
+    status = AudioOutputUnitStart(output_unit);
+
+  if (status != noErr) {
+    DaemonLog("Audio output unavailable (OSStatus %d)\n", (int)status);
+    return;
+  }
+  DaemonLog("Audio: CoreAudio %s, %u Hz, %u-frame buffer requested "
+            "(%.2f ms)\n",
+            audio_config.exclusive ? "hog mode" : "shared", output_rate,
+            (unsigned)period_frames, audio_config.period_ms);
+}
@@ -0,0 +1,604 @@
+// POSIX backend, shared by Linux and macOS: the AF_UNIX socket server on
+// a single-threaded readiness loop, the single-instance lock with socket
+// handoff, and file access. Poller and audio come from the kernel files.
+#define _DEFAULT_SOURCE  // flock, CMSG_* and friends under strict C23
+#define _DARWIN_C_SOURCE
+
+#include "platform.h"
+#include "platform_posix.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================================
+// CONSTANTS & MACROS
+// ============================================================
+static constexpr size_t SOCKET_PATH_MAX =
+    sizeof((struct sockaddr_un){0}.sun_path);
+static constexpr int64_t NANOS_PER_SECOND = 1000000000;
+static constexpr int CONTROL_TIMEOUT_MS = 100; // One short exchange per accept
+static constexpr int HANDOFF_TIMEOUT_MS = 5000;
+static constexpr size_t STATS_BUFFER_SIZE = 4096; // Fits a stats snapshot
+
+// ============================================================
+// SOCKET SERVER STATE (Event loop thread only)
+// ============================================================
+typedef struct {
+  PollSource source; // First member: the poller hands back its address
+  ClientSession client;
+} SocketClient;
+
+static_assert(offsetof(SocketClient, source) == 0);
+
+const size_t platform_session_bytes = sizeof(SocketClient);
+
+// Everything lives next to the stream socket the editor connects to:
+//   $XDG_RUNTIME_DIR (or $TMPDIR, or /tmp)/nvim_clack-<uid>.sock
+static char socket_path[SOCKET_PATH_MAX];
+static char control_path[SOCKET_PATH_MAX];
+static char stats_path[SOCKET_PATH_MAX];
+static char lock_path[SOCKET_PATH_MAX];
+static char bus_path[SOCKET_PATH_MAX]; // A plain file, mapped shared
+
+static SocketClient *socket_clients = nullptr; // pool_config.clients long
+static PollSource listener = {.kind = SOURCE_LISTENER, .fd = -1};
+static PollSource control_listener = {.kind = SOURCE_CONTROL, .fd = -1};
+static PollSource stats_listener = {.kind = SOURCE_STATS, .fd = -1};
+static PollSource sound_source = {.kind = SOURCE_SOUNDS, .fd = -1};
+static PollSource signal_source = {.kind = SOURCE_SIGNAL, .fd = -1};
+static bool reload_requested = false;
+static bool embedded = false; // Library mode: no event loop at all
+
+// ============================================================
+// CLOCK, PROCESS AND FILES
+// ============================================================
+int64_t PlatformClockRate(void) { return NANOS_PER_SECOND; }
+
+int64_t PlatformNowTicks(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+// Editors spawn us with stdout on /dev/null; a terminal or a pipe means
+// somebody is reading the log.
+bool PlatformHasOutputStream(void) {
+  struct stat info;
+  if (fstat(STDOUT_FILENO, &info) != 0)
+    return false;
+  return !S_ISCHR(info.st_mode) || isatty(STDOUT_FILENO);
+}
+
+unsigned long PlatformProcessId(void) { return (unsigned long)getpid(); }
+
+void PlatformYield(void) { sched_yield(); }
+
+void PlatformSleep(uint32_t ms) {
+  const struct timespec delay = {
+      .tv_sec = ms / 1000,
+      .tv_nsec = (long)(ms % 1000) * 1000000L,
+  };
+  nanosleep(&delay, nullptr);
+}
+
+// Function pointers can't ride in a void *, so the body travels boxed
+static void *CoreThread(void *parameter) {
+  void (**body)(void) = parameter;
+  void (*run)(void) = *body;
+  free(body);
+  run();
+  return nullptr;
+}
+
+bool PlatformStartThread(void (*body)(void)) {
+  void (**start)(void) = malloc(sizeof(*start));
+  if (start == nullptr)
+    return false;
+  *start = body;
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, CoreThread, start) != 0) {
+    free(start);
+    return false;
+  }
+  pthread_detach(thread);
+  return true;
+}
+
+bool PlatformFileStamp(const char *path, uint64_t *stamp) {
+  struct stat info;
+  if (stat(path, &info) != 0)
+    return false;
+#if defined(__APPLE__)
+  const struct timespec modified = info.st_mtimespec;
+#else
+  const struct timespec modified = info.st_mtim;
+#endif
+  *stamp = (uint64_t)modified.tv_sec * (uint64_t)NANOS_PER_SECOND +
+           (uint64_t)modified.tv_nsec;
+  return true;
+}
+
+uint8_t *PlatformReadFile(const char *path, uint32_t max_bytes,
+                          uint32_t *size) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+
+  uint8_t *image = nullptr;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0 &&
+      (uint64_t)info.st_size <= max_bytes) {
+    const size_t length = (size_t)info.st_size;
+    image = malloc(length);
+    if (image != nullptr && read(fd, image, length) != (ssize_t)length) {
+      free(image);
+      image = nullptr;
+    }
+    *size = (uint32_t)length;
+  }
+  close(fd);
+  return image;
+}
+
+// Moving another program's window has no portable equivalent (and
+// Wayland forbids it outright), so the shake is Windows-only.
+void PlatformShake([[maybe_unused]] const EffectTarget *target) {}
+
+// Same for asking the window manager to flash someone else's window
+void PlatformFlash([[maybe_unused]] const EffectTarget *target) {}
+
+uint64_t PlatformConsoleWindow(void) { return 0; }
+
+// The shared-memory rings are built on named Win32 sections and events;
+// Unix clients stay on the socket.
+int PlatformClaimRing([[maybe_unused]] const EffectTarget *owner) {
+  return -1;
+}
+
+// ============================================================
+// SOCKET HELPERS
+// ============================================================
+[[nodiscard]]
+static bool FormatRuntimePath(char *out, const char *directory,
+                              const char *name, const char *suffix) {
+  const size_t length = strlen(directory);
+  const char *separator =
+      length > 0 && directory[length - 1] == '/' ? "" : "/";
+  const int written = snprintf(out, SOCKET_PATH_MAX, "%s%s%s-%u.%s",
+                               directory, separator, name,
+                               (unsigned)getuid(), suffix);
+  return written > 0 && (size_t)written < SOCKET_PATH_MAX;
+}
+
+[[nodiscard]]
+static bool ResolveRuntimePaths(void) {
+  const char *directory = getenv("XDG_RUNTIME_DIR");
+  if (directory == nullptr || directory[0] == '\0') {
+    directory = getenv("TMPDIR");
+  }
+  if (directory == nullptr || directory[0] == '\0') {
+    directory = "/tmp";
+  }
+  return FormatRuntimePath(socket_path, directory, "nvim_clack", "sock") &&
+         FormatRuntimePath(control_path, directory, "nvim_clack_ctl",
+                           "sock") &&
+         FormatRuntimePath(stats_path, directory, "nvim_clack_stats",
+                           "sock") &&
+         FormatRuntimePath(lock_path, directory, "nvim_clack", "lock") &&
+         FormatRuntimePath(bus_path, directory, "nvim_clack_bus", "shm");
+}
+
+// macOS has no SOCK_CLOEXEC/SOCK_NONBLOCK, so every descriptor goes here
+[[nodiscard]]
+static bool SetDescriptorFlags(int fd, bool nonblocking) {
+  const int fd_flags = fcntl(fd, F_GETFD);
+  const int status_flags = fcntl(fd, F_GETFL);
+  if (fd_flags < 0 || status_flags < 0)
+    return false;
+  const int wanted = nonblocking ? status_flags | O_NONBLOCK
+                                 : status_flags & ~O_NONBLOCK;
+  return fcntl(fd, F_SETFD, fd_flags | FD_CLOEXEC) == 0 &&
+         fcntl(fd, F_SETFL, wanted) == 0;
+}
+
+[[nodiscard]]
+static bool FillSocketAddress(struct sockaddr_un *address, const char *path) {
+  const size_t length = strlen(path);
+  if (length >= sizeof(address->sun_path))
+    return false;
+  *address = (struct sockaddr_un){.sun_family = AF_UNIX};
+  memcpy(address->sun_path, path, length + 1);
+  return true;
+}
+
+// Only called while holding the instance lock, so whatever sits at `path`
+// belongs to a daemon that is gone and is safe to replace.
+[[nodiscard]]
+static int OpenListener(const char *path) {
+  struct sockaddr_un address;
+  if (!FillSocketAddress(&address, path))
+    return -1;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  unlink(path);
+  // Owner-only from the moment the name exists; /tmp is shared
+  const mode_t previous_mask = umask(S_IRWXG | S_IRWXO);
+  const bool bound =
+      bind(fd, (const struct sockaddr *)&address, sizeof(address)) == 0;
+  umask(previous_mask);
+  if (!bound || !SetDescriptorFlags(fd, true) ||
+      listen(fd, pool_config.clients) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Sends `reply`, passing `passed_fd` along with it when it is not -1
+static void SendReply(int fd, const char *reply, int passed_fd) {
+  struct iovec data = {.iov_base = (void *)reply, .iov_len = strlen(reply)};
+  struct msghdr message = {.msg_iov = &data, .msg_iovlen = 1};
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {0};
+  if (passed_fd >= 0) {
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &passed_fd, sizeof(int));
+  }
+  (void)sendmsg(fd, &message, 0);
+}
+
+// Accepted sockets answer one request with plain blocking I/O; BSD hands
+// down O_NONBLOCK from the listener, so clear it and bound the wait.
+[[nodiscard]]
+static int AcceptServiceClient(int listen_fd) {
+  const int fd = accept(listen_fd, nullptr, nullptr);
+  if (fd < 0)
+    return -1;
+  const struct timeval timeout = {.tv_usec = CONTROL_TIMEOUT_MS * 1000};
+  if (!SetDescriptorFlags(fd, false) ||
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) !=
+          0 ||
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) !=
+          0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// ============================================================
+// EDITOR CONNECTIONS
+// ============================================================
+static void CloseClient(SocketClient *socket_client) {
+  PollerRemove(&socket_client->source);
+  close(socket_client->source.fd);
+  socket_client->source.fd = -1;
+}
+
+static void AcceptClients(void) {
+  while (true) {
+    const int fd = accept(listener.fd, nullptr, nullptr);
+    if (fd < 0)
+      return; // Backlog drained (or a transient failure; level-triggered)
+
+    SocketClient *slot = nullptr;
+    for (int i = 0; i < pool_config.clients && slot == nullptr; i++) {
+      if (socket_clients[i].source.fd < 0) {
+        slot = &socket_clients[i];
+      }
+    }
+    if (slot == nullptr) {
+      DaemonLog("Client limit (%d) reached; refusing connection\n",
+                pool_config.clients);
+      close(fd);
+      continue;
+    }
+
+    slot->source.fd = fd;
+    if (!SetDescriptorFlags(fd, true) || !PollerAdd(&slot->source)) {
+      close(fd);
+      slot->source.fd = -1;
+      continue;
+    }
+    SessionOpen(&slot->client);
+  }
+}
+
+static void ReadClient(SocketClient *socket_client) {
+  ClientSession *client = &socket_client->client;
+  const ssize_t bytes =
+      read(socket_client->source.fd, client->buffer + client->buffered,
+           READ_BUFFER_SIZE - client->buffered);
+  if (bytes < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+  if (bytes <= 0) {
+    // EOF is the editor going away; anything else ends the session too
+    SessionClosed(client);
+    CloseClient(socket_client);
+    return;
+  }
+  if (!SessionReceive(client, (uint32_t)bytes, PlatformNowTicks())) {
+    CloseClient(socket_client);
+  }
+}
+
+// ============================================================
+// CONTROL & STATS SOCKETS
+// ============================================================
+static void AnswerControlClient(void) {
+  const int fd = AcceptServiceClient(control_listener.fd);
+  if (fd < 0)
+    return;
+
+  char command[CONTROL_COMMAND_MAX];
+  ssize_t length = read(fd, command, sizeof(command) - 1);
+  if (length < 0) {
+    close(fd);
+    return;
+  }
+  while (length > 0 &&
+         (command[length - 1] == '\n' || command[length - 1] == '\r' ||
+          command[length - 1] == ' ')) {
+    length--;
+  }
+  command[length] = '\0';
+
+  char reply[CONTROL_COMMAND_MAX];
+  const ControlAction action =
+      HandleControlCommand(command, reply, sizeof(reply));
+  // A successor taking over gets the editor socket itself, so editors
+  // connecting mid-handoff queue on the same listener instead of failing
+  const bool handoff =
+      action == CONTROL_EXIT && strcmp(command, "handoff") == 0;
+  SendReply(fd, reply, handoff ? listener.fd : -1);
+  close(fd);
+
+  if (action == CONTROL_EXIT) {
+    DaemonLog("Handing off; exiting\n");
+    exit(EXIT_SUCCESS); // The instance lock goes with the process
+  }
+}
+
+static void AnswerStatsClient(void) {
+  const int fd = AcceptServiceClient(stats_listener.fd);
+  if (fd < 0)
+    return;
+  char snapshot[STATS_BUFFER_SIZE];
+  const int length = FormatStatsJson(snapshot, sizeof(snapshot));
+  (void)write(fd, snapshot, (size_t)length);
+  close(fd);
+}
+
+// Asks the running daemon to step aside and receives its editor socket.
+// Returns the listener, or -1 if the daemon did not hand it over.
+[[nodiscard]]
+static int TakeOverListener(void) {
+  struct sockaddr_un address;
+  if (!FillSocketAddress(&address, control_path))
+    return -1;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  static const char command[] = "handoff";
+  const struct timeval timeout = {.tv_sec = HANDOFF_TIMEOUT_MS / 1000};
+  char reply[CONTROL_COMMAND_MAX];
+  struct iovec data = {.iov_base = reply, .iov_len = sizeof(reply) - 1};
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {0};
+  struct msghdr message = {
+      .msg_iov = &data,
+      .msg_iovlen = 1,
+      .msg_control = control,
+      .msg_controllen = sizeof(control),
+  };
+
+  int received = -1;
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) ==
+          0 &&
+      connect(fd, (const struct sockaddr *)&address, sizeof(address)) == 0 &&
+      write(fd, command, sizeof(command) - 1) ==
+          (ssize_t)(sizeof(command) - 1) &&
+      recvmsg(fd, &message, 0) > 0) {
+    const struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (header != nullptr && header->cmsg_level == SOL_SOCKET &&
+        header->cmsg_type == SCM_RIGHTS) {
+      memcpy(&received, CMSG_DATA(header), sizeof(int));
+    }
+  }
+  if (received < 0) {
+    DaemonLog("Running daemon did not accept handoff (%s)\n",
+              strerror(errno));
+  }
+  close(fd);
+  if (received >= 0 && !SetDescriptorFlags(received, true)) {
+    close(received);
+    received = -1;
+  }
+  return received;
+}
+
+// ============================================================
+// EVENT LOOP
+// ============================================================
+// Library mode has no loop to defer the first load to, so a thread of its
+// own does it and then follows sounds/ for the host's lifetime.
+static void *EmbeddedWatchThread([[maybe_unused]] void *parameter) {
+  ReloadSoundBank(true);
+  PollSource *ready[POLLER_BATCH];
+  while (sound_source.fd >= 0) {
+    const int count = PollerWait(ready);
+    if (count < 0)
+      break;
+    for (int i = 0; i < count; i++) {
+      PollerDrain(ready[i]);
+    }
+    if (count > 0) {
+      ReloadSoundBank(false);
+    }
+  }
+  return nullptr;
+}
+
+void PlatformStartAudio(void) {
+  StartAudioOutput();
+  if (!PollerWatchDirectory(&sound_source, SOUNDS_DIR)) {
+    DaemonLog("Not watching %s (%s)\n", SOUNDS_DIR, strerror(errno));
+  }
+  if (!embedded) {
+    PlatformRequestReload();
+    return;
+  }
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, EmbeddedWatchThread, nullptr) == 0) {
+    pthread_detach(thread);
+  }
+}
+
+// Always on the loop thread here; the reload runs once the current batch
+// of ready sources is handled, so the event that asked for it goes first.
+void PlatformRequestReload(void) { reload_requested = true; }
+
+static void DispatchSource(PollSource *source) {
+  switch (source->kind) {
+  case SOURCE_LISTENER:
+    AcceptClients();
+    break;
+  case SOURCE_CLIENT:
+    if (source->fd >= 0) { // May have closed earlier in this batch
+      ReadClient((SocketClient *)source);
+    }
+    break;
+  case SOURCE_CONTROL:
+    AnswerControlClient();
+    break;
+  case SOURCE_STATS:
+    AnswerStatsClient();
+    break;
+  case SOURCE_SOUNDS:
+    PollerDrain(source);
+    ReloadSoundBank(false);
+    break;
+  case SOURCE_SIGNAL:
+    DaemonLog("Shutting down\n");
+    exit(EXIT_SUCCESS);
+  }
+}
+
+// ============================================================
+// DAEMON LIFECYCLE
+// ============================================================
+int PlatformRunDaemon(void) {
+  signal(SIGPIPE, SIG_IGN); // A client hanging up mid-reply is not fatal
+  if (!ResolveRuntimePaths()) {
+    DaemonLog("Runtime directory path is too long for a socket\n");
+    return EXIT_FAILURE;
+  }
+
+  // Every editor launch runs us; all but the first should cost nothing
+  const int instance_lock =
+      open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (instance_lock < 0)
+    return EXIT_FAILURE;
+  const bool already_running = flock(instance_lock, LOCK_EX | LOCK_NB) != 0;
+  if (already_running && !takeover_requested) {
+    DaemonLog("Daemon already running; exiting\n");
+    return EXIT_SUCCESS;
+  }
+
+  // Signals are masked before any other thread exists
+  if (!PollerOpen() || !PollerWatchSignals(&signal_source)) {
+    DaemonLog("Could not start event loop (%s)\n", strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  // The old daemon exits right after handing over its listener, and its
+  // lock is released with it
+  listener.fd =
+      already_running ? TakeOverListener() : OpenListener(socket_path);
+  if (already_running && listener.fd >= 0 &&
+      flock(instance_lock, LOCK_EX) != 0)
+    return EXIT_FAILURE;
+  if (listener.fd < 0 || !PollerAdd(&listener)) {
+    DaemonLog("Could not start socket server (%s)\n", strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  socket_clients =
+      ArenaAlloc(sizeof(SocketClient) * (size_t)pool_config.clients);
+  if (socket_clients == nullptr)
+    return EXIT_FAILURE;
+  for (int i = 0; i < pool_config.clients; i++) {
+    socket_clients[i].source = (PollSource){.kind = SOURCE_CLIENT, .fd = -1};
+  }
+  ArenaSeal();
+  control_listener.fd = OpenListener(control_path);
+  stats_listener.fd = OpenListener(stats_path);
+  const bool control_ok =
+      control_listener.fd >= 0 && PollerAdd(&control_listener);
+  const bool stats_ok = stats_listener.fd >= 0 && PollerAdd(&stats_listener);
+  if (!control_ok || !stats_ok) {
+    DaemonLog("Could not open control/stats sockets (%s)\n", strerror(errno));
+  }
+  DaemonLog("Listening on %s (%d clients)\n", socket_path,
+            pool_config.clients);
+  DaemonLog("Stats on %s\n", stats_path);
+  StartIntensityBus();
+
+  PollSource *ready[POLLER_BATCH];
+  while (true) {
+    const int count = PollerWait(ready);
+    if (count < 0)
+      return EXIT_FAILURE;
+    for (int i = 0; i < count; i++) {
+      DispatchSource(ready[i]);
+    }
+    if (reload_requested) {
+      reload_requested = false;
+      ReloadSoundBank(true);
+    }
+  }
+}
+
+// The runtime directory is usually tmpfs, so the file never hits a disk.
+// ftruncate zero-fills a new one and leaves an existing one as it was.
+void *PlatformMapBus(size_t bytes) {
+  const int fd =
+      open(bus_path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return nullptr;
+  void *view = ftruncate(fd, (off_t)bytes) == 0
+                   ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          fd, 0)
+                   : MAP_FAILED;
+  close(fd); // The mapping keeps the file open
+  if (view == MAP_FAILED)
+    return nullptr;
+  DaemonLog("Intensity bus on %s\n", bus_path);
+  return view;
+}
+
+// The watch thread gets a poller of its own; signals stay the host's
+bool PlatformStartEmbedded(void) {
+  embedded = true;
+  return PollerOpen();
+}
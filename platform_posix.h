@@ -0,0 +1,51 @@
+#pragma once
+
+// Internal to the POSIX backends. platform_posix.c runs the socket server,
+// the single-instance lock and file access for both Unix targets; each of
+// platform_linux.c and platform_macos.c supplies the readiness poller and
+// the audio output for its kernel and sound stack.
+
+// ============================================================
+// READINESS POLLER (epoll on Linux, kqueue on macOS)
+// ============================================================
+typedef enum {
+  SOURCE_LISTENER, // Editor socket: accept
+  SOURCE_CLIENT,   // One editor connection: read
+  SOURCE_CONTROL,  // nvim_clack_ctl socket: accept, one command
+  SOURCE_STATS,    // nvim_clack_stats socket: accept, one snapshot
+  SOURCE_SOUNDS,   // sounds/ changed
+  SOURCE_SIGNAL,   // SIGINT/SIGTERM/SIGHUP
+} SourceKind;
+
+// Registered by address; whatever embeds it must outlive the registration
+typedef struct {
+  SourceKind kind;
+  int fd;
+} PollSource;
+
+static constexpr int POLLER_BATCH = 32; // Ready sources handled per wake-up
+
+[[nodiscard]]
+bool PollerOpen(void);
+[[nodiscard]]
+bool PollerAdd(PollSource *source); // Level-triggered readability
+void PollerRemove(PollSource *source);
+// Blocks until a source is ready. Returns how many were stored (0 after a
+// signal interrupted the wait), or -1 if the poller itself broke.
+[[nodiscard]]
+int PollerWait(PollSource *ready[POLLER_BATCH]);
+
+// Directory and signal sources need kernel-specific setup, and Linux
+// wants their queued records read back before the next wait.
+[[nodiscard]]
+bool PollerWatchDirectory(PollSource *source, const char *path);
+[[nodiscard]]
+bool PollerWatchSignals(PollSource *source);
+void PollerDrain(PollSource *source);
+
+// ============================================================
+// AUDIO OUTPUT
+// ============================================================
+// Opens the default output and starts pulling from the core's mixer on
+// the platform's real-time audio thread. Never blocks the caller.
+void StartAudioOutput(void);
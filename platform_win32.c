@@ -0,0 +1,2268 @@
+// Windows backend: overlapped named pipes on one completion port, a WASAPI
+// render thread, and the terminal shake on a dedicated effects worker.
+#define WIN32_LEAN_AND_MEAN
+#define COBJMACROS
+
+// clang-format off
+#include <windows.h>
+#include <objbase.h>
+#include <mmreg.h>
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#include <dwmapi.h>
+#include <avrt.h>
+// clang-format on
+
+#include "mpsc_ring.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CLICKER_TRAP_HEAP)
+#include <crtdbg.h>
+#endif
+
+// Link with ole32.lib (COM activation of the WASAPI endpoint)
+#pragma comment(lib, "ole32.lib")
+// Link with dwmapi.lib (DwmFlush frame pacing for the shake)
+#pragma comment(lib, "dwmapi.lib")
+// Link with gdi32.lib (screen snapshot for the overlay shake)
+#pragma comment(lib, "gdi32.lib")
+// Link with avrt.lib (MMCSS registration of the latency-critical threads)
+#pragma comment(lib, "avrt.lib")
+
+// ============================================================
+// GLOBALS
+// ============================================================
+static int64_t qpc_ticks_per_second = 1; // Set once by PlatformClockRate()
+static bool daemon_mode = false; // PlatformRunDaemon, not the library
+
+// ============================================================
+// CONSTANTS & MACROS
+// ============================================================
+static const char *const PIPE_NAME = "\\\\.\\pipe\\nvim_clack";
+static constexpr DWORD PIPE_BUFFER_SIZE = 1024;
+static constexpr DWORD PIPE_MAX_INST = PIPE_UNLIMITED_INSTANCES;
+
+// One daemon per login session; a second launch exits or takes over
+static const char *const INSTANCE_MUTEX_NAME = "Local\\nvim_clack_daemon";
+static const char *const CONTROL_PIPE_NAME = "\\\\.\\pipe\\nvim_clack_ctl";
+static const char *const STATS_PIPE_NAME = "\\\\.\\pipe\\nvim_clack_stats";
+static constexpr DWORD HANDOFF_TIMEOUT_MS = 5000;
+
+static constexpr double SHAKE_FREQUENCY_HZ = 14.0;
+static constexpr double SHAKE_DECAY = 4.0; // e^-4: ~2% amplitude at the end
+static constexpr double FALLBACK_REFRESH_HZ = 60.0;
+static constexpr double TWO_PI = 6.28318530717958647692;
+static const wchar_t *const MMCSS_TASK_NAME = L"Pro Audio";
+static const char *const OVERLAY_CLASS_NAME = "nvim_clack_overlay";
+
+// Older SDKs predate the flag (Windows 10 1803+); the value is fixed ABI
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// ============================================================
+// EFFECTS WORKER TYPES (One long-lived thread for window effects)
+// ============================================================
+typedef enum {
+  EFFECT_SHAKE,
+  EFFECT_FLASH,
+} EffectKind;
+
+typedef struct {
+  uint8_t kind;
+  EffectTarget target;
+} EffectRequest;
+
+// A burst of requests collapses to one effect per kind, aimed at the
+// window of the newest request
+typedef struct {
+  int shakes;
+  int flashes;
+  EffectTarget shake_target;
+  EffectTarget flash_target;
+} EffectCounts;
+
+// Paces one animation step per compositor frame. DwmFlush is the primary
+// clock; the high-resolution waitable timer covers the cases where DWM
+// won't block (session locked, composition unavailable), without touching
+// the global timer resolution like timeBeginPeriod would.
+typedef struct {
+  HANDLE timer;
+  LONGLONG frame_hns;
+} FramePacer;
+
+// The terminal's pixels for the overlay shake, in a memory DC
+typedef struct {
+  HDC dc;
+  HBITMAP bitmap;
+  HGDIOBJ previous; // Selected back before the bitmap is freed
+} Snapshot;
+
+static constexpr size_t EFFECT_QUEUE_CAPACITY = 16; // Power of two
+static constexpr int SHAKE_MAX_RESTARTS = 3; // Save spam can't shake forever
+
+DEFINE_MPSC_RING(EffectRing, EffectRequest, EFFECT_QUEUE_CAPACITY)
+static EffectRing effect_queue;
+static HANDLE effect_wake_event = nullptr; // Auto-reset
+static INIT_ONCE effects_worker_once = INIT_ONCE_STATIC_INIT;
+static FramePacer frame_pacer;             // Effects worker only
+static ATOM overlay_class = 0;             // Effects worker only
+
+// Windows 10 1607+, so looked up once by the effects worker. Without them
+// the worker stays DPI-unaware and amplitudes are plain pixels.
+typedef UINT(WINAPI *GetDpiForWindowFn)(HWND);
+typedef DPI_AWARENESS_CONTEXT(WINAPI *SetThreadDpiAwarenessContextFn)(
+    DPI_AWARENESS_CONTEXT);
+static GetDpiForWindowFn get_dpi_for_window = nullptr; // Effects worker only
+
+// ============================================================
+// WINDOW SEARCH TYPES
+// ============================================================
+typedef struct {
+  DWORD target_pid;
+  HWND best_hwnd;
+  long max_area;
+} WindowSearchParams;
+
+static constexpr int MIN_WINDOW_DIMENSION = 100;
+
+// ============================================================
+// TERMINAL WINDOW CACHE (PID -> frame HWND, effects worker only)
+// ============================================================
+// EnumWindows walks every top-level window on the desktop, so the result
+// is remembered per process. A WinEvent hook scoped to each cached PID
+// drops the entry when its window is destroyed, and a global foreground
+// hook marks it stale when another sizeable window of that PID comes up.
+typedef struct {
+  DWORD pid;                  // 0 marks an empty entry
+  HWND hwnd;                  // nullptr while stale (rescan on next use)
+  HWINEVENTHOOK destroy_hook; // Scoped to `pid`
+} TerminalCacheEntry;
+
+static constexpr int TERMINAL_CACHE_SIZE = 8;
+static TerminalCacheEntry terminal_cache[TERMINAL_CACHE_SIZE];
+static int terminal_cache_next = 0; // Round-robin eviction cursor
+
+// ============================================================
+// SOUND WATCH TYPES
+// ============================================================
+// ReadDirectoryChangesW on sounds/, completed on the pipe server's port.
+// The records are never parsed: any change re-checks every slot.
+static constexpr DWORD SOUND_WATCH_BUFFER_BYTES = 1024;
+
+typedef struct {
+  OVERLAPPED overlapped;
+  HANDLE directory;
+  DWORD changes[SOUND_WATCH_BUFFER_BYTES / sizeof(DWORD)]; // DWORD-aligned
+} SoundWatch;
+
+static SoundWatch sound_watch = {.directory = INVALID_HANDLE_VALUE};
+static SRWLOCK sound_bank_lock = SRWLOCK_INIT; // Reloads may race otherwise
+
+// ============================================================
+// PIPE SERVER TYPES (Overlapped instances on one completion port)
+// ============================================================
+typedef enum {
+  SESSION_CONNECTING,
+  SESSION_READING,
+} SessionState;
+
+// Each instance has at most one I/O in flight, so only the worker that
+// dequeued its completion ever touches it; no locking needed.
+typedef struct {
+  OVERLAPPED overlapped; // Completion packets map back via CONTAINING_RECORD
+  HANDLE pipe;
+  SessionState state;
+  ClientSession client;
+} PipeSession;
+
+const size_t platform_session_bytes = sizeof(PipeSession);
+
+// Everything the daemon waits on completes on one port; the key says what
+// the OVERLAPPED belongs to.
+typedef enum {
+  COMPLETION_SESSION,  // PipeSession
+  COMPLETION_SERVICE,  // ServicePipe (control or stats)
+  COMPLETION_SOUNDS,   // SoundWatch
+  COMPLETION_RELOAD,   // Posted: force-reload the sound bank
+  COMPLETION_SHUTDOWN, // Posted: console close or Ctrl+C
+} CompletionKey;
+
+static constexpr DWORD SERVICE_BUFFER_SIZE = 4096; // Fits a stats snapshot
+
+typedef enum {
+  SERVICE_CONTROL,
+  SERVICE_STATS,
+  SERVICE_COUNT
+} ServiceKind;
+
+typedef enum {
+  SERVICE_CONNECTING,
+  SERVICE_READING,  // Control only: waiting for the command message
+  SERVICE_WRITING,  // Reply or snapshot on its way out
+  SERVICE_DRAINING, // Written; waiting for the client to hang up
+} ServiceState;
+
+// Local request/reply endpoints. One instance each, one message each way,
+// then the client closes. Disconnecting earlier would discard the reply.
+typedef struct {
+  OVERLAPPED overlapped; // Completion packets map back via CONTAINING_RECORD
+  HANDLE pipe;
+  ServiceKind kind;
+  ServiceState state;
+  bool exit_when_drained; // "handoff"/"quit" was answered
+  char buffer[SERVICE_BUFFER_SIZE];
+} ServicePipe;
+
+static PipeSession *pipe_pool = nullptr; // pool_config.clients long
+static ServicePipe service_pipes[SERVICE_COUNT];
+static HANDLE completion_port = nullptr;
+
+// ============================================================
+// SHARED-MEMORY RING TYPES (Opt-in transport, one ring per editor)
+// ============================================================
+// A client claims a ring with the control command "ring <pid>", maps
+// RING_MAPPING_NAME and publishes an event by filling the cell at `head`
+// and storing `head + 1`. The consumer only sleeps on RING_WAKE_NAME after
+// raising `consumer_idle`, so while it is busy producers skip SetEvent.
+// The producer has no fence between its head store and that check, so
+// a wake can be missed; while any ring is claimed the consumer's sleep
+// is bounded and it looks at the heads again when it times out.
+// The layout is mirrored by the ffi.cdef in init.lua; bump RING_VERSION
+// whenever it changes.
+static const char *const RING_MAPPING_NAME = "Local\\nvim_clack_ring";
+static const char *const RING_WAKE_NAME = "Local\\nvim_clack_ring_wake";
+static constexpr uint32_t RING_MAGIC = 0x4752434E; // "NCRG"
+static constexpr uint32_t RING_VERSION = 1;
+static constexpr int RING_COUNT = 8;
+static constexpr uint32_t RING_CAPACITY = 256; // Events, power of two
+static constexpr int RING_IDLE_SPINS = 256;
+// Timed-out waits double from the first to the last; any event resets
+static constexpr DWORD RING_IDLE_WAIT_FIRST_MS = 1;
+static constexpr DWORD RING_IDLE_WAIT_LAST_MS = 64;
+
+// Producer and consumer indices sit on separate cache lines
+typedef struct {
+  _Atomic uint32_t head; // Client only: events published, free-running
+  uint32_t owner_pid;    // Daemon only: 0 while the ring is free
+  uint8_t producer_pad[56];
+  _Atomic uint32_t tail; // Daemon only: events consumed, free-running
+  uint8_t consumer_pad[60];
+  ClackEvent events[RING_CAPACITY];
+} EventRing;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t ring_count;
+  uint32_t capacity;
+  _Atomic uint32_t consumer_idle; // 1 while the daemon waits for a wake
+  uint8_t header_pad[44];
+  EventRing rings[RING_COUNT];
+} RingArea;
+
+static_assert(offsetof(EventRing, tail) == 64);
+static_assert(offsetof(EventRing, events) == 128);
+static_assert(offsetof(RingArea, rings) == 64);
+
+typedef struct {
+  HANDLE owner; // Process handle; nullptr marks a free ring
+  ClientSession client;
+} RingClient;
+
+static RingArea *ring_area = nullptr;
+static HANDLE ring_wake_event = nullptr; // Auto-reset
+static RingClient ring_clients[RING_COUNT];
+static SRWLOCK ring_lock = SRWLOCK_INIT; // Claims vs the consumer thread
+static INIT_ONCE ring_area_once = INIT_ONCE_STATIC_INIT;
+
+// ============================================================
+// WASAPI TYPES (Event-driven render thread)
+// ============================================================
+typedef enum {
+  SAMPLE_FORMAT_FLOAT32,
+  SAMPLE_FORMAT_INT16,
+  SAMPLE_FORMAT_INT32,
+} SampleFormat;
+
+typedef struct {
+  IAudioClient *client;
+  IAudioRenderClient *render;
+  HANDLE ready_event;
+  UINT32 buffer_frames;
+  UINT32 sample_rate;
+  WORD channels;
+  SampleFormat sample_format;
+  bool exclusive;
+  float *mix; // MIX_CHANNELS interleaved, buffer_frames long
+} AudioDevice;
+
+static constexpr WORD WAVE_FORMAT_PCM_ = 1;
+static constexpr double HNS_PER_MS = 10000.0;
+static constexpr DWORD AUDIO_EVENT_TIMEOUT_MS = 2000;
+static constexpr HRESULT AUDIO_DEVICE_CHANGED = S_FALSE; // Reopen right away
+static constexpr HRESULT AUDIO_IDLE = 2; // Success code: park until an event
+
+static HANDLE audio_device_event = nullptr; // Auto-reset, endpoint changes
+static HANDLE audio_wake_event = nullptr;   // Auto-reset, PlatformWakeAudio
+
+// WASAPI identifiers, spelled out so we don't depend on uuid.lib exports
+static const CLSID CLSID_MMDeviceEnumerator_ = {
+    0xBCDE0395,
+    0xE52F,
+    0x467C,
+    {0x8E, 0x3D, 0xC4, 0x57, 0x92, 0x91, 0x69, 0x2E}};
+static const IID IID_IMMDeviceEnumerator_ = {
+    0xA95664D2,
+    0x9614,
+    0x4F35,
+    {0xA7, 0x46, 0xDE, 0x8D, 0xB6, 0x36, 0x17, 0xE6}};
+static const IID IID_IAudioClient_ = {
+    0x1CB9AD4C,
+    0xDBFA,
+    0x4C32,
+    {0xB1, 0x78, 0xC2, 0xF5, 0x68, 0xA7, 0x03, 0xB2}};
+static const IID IID_IAudioClient3_ = {
+    0x7ED4EE07,
+    0x8E67,
+    0x4CD4,
+    {0x8C, 0x1A, 0x2B, 0x7A, 0x59, 0x87, 0xAD, 0x42}};
+static const IID IID_IAudioRenderClient_ = {
+    0xF294ACFC,
+    0x3146,
+    0x4483,
+    {0xA7, 0xBF, 0xAD, 0xDC, 0xA7, 0xC2, 0x60, 0xE2}};
+static const GUID SUBTYPE_PCM_ = {
+    0x00000001,
+    0x0000,
+    0x0010,
+    {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+static const GUID SUBTYPE_IEEE_FLOAT_ = {
+    0x00000003,
+    0x0000,
+    0x0010,
+    {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+static const IID IID_IUnknown_ = {
+    0x00000000,
+    0x0000,
+    0x0000,
+    {0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46}};
+static const IID IID_IMMNotificationClient_ = {
+    0x7991EEC9,
+    0x7E89,
+    0x4D85,
+    {0x83, 0x90, 0x6C, 0x70, 0x3C, 0xEC, 0x60, 0xC0}};
+
+// ============================================================
+// CLOCK, PROCESS & FILES
+// ============================================================
+int64_t PlatformClockRate(void) {
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  qpc_ticks_per_second = frequency.QuadPart;
+  return qpc_ticks_per_second;
+}
+
+int64_t PlatformNowTicks(void) {
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return now.QuadPart;
+}
+
+// Detached launches (jobstart with detach = true) have no stdout at all
+bool PlatformHasOutputStream(void) {
+  HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+  return output != nullptr && output != INVALID_HANDLE_VALUE &&
+         GetFileType(output) != FILE_TYPE_UNKNOWN;
+}
+
+unsigned long PlatformProcessId(void) {
+  return GetCurrentProcessId();
+}
+
+void PlatformYield(void) {
+  SwitchToThread();
+}
+
+void PlatformSleep(uint32_t ms) {
+  Sleep(ms);
+}
+
+// Function pointers can't ride in a void *, so the body travels boxed
+static DWORD WINAPI CoreThread(void *parameter) {
+  void (**body)(void) = parameter;
+  void (*run)(void) = *body;
+  free(body);
+  run();
+  return 0;
+}
+
+bool PlatformStartThread(void (*body)(void)) {
+  void (**start)(void) = malloc(sizeof(*start));
+  if (start == nullptr)
+    return false;
+  *start = body;
+  HANDLE thread = CreateThread(nullptr, 0, CoreThread, start, 0, nullptr);
+  if (thread == nullptr) {
+    free(start);
+    return false;
+  }
+  CloseHandle(thread);
+  return true;
+}
+
+bool PlatformFileStamp(const char *path, uint64_t *stamp) {
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (GetFileAttributesExA(path, GetFileExInfoStandard, &attributes) == FALSE)
+    return false;
+
+  *stamp = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+           attributes.ftLastWriteTime.dwLowDateTime;
+  return true;
+}
+
+uint8_t *PlatformReadFile(const char *path, uint32_t max_bytes,
+                          uint32_t *size) {
+  HANDLE file = CreateFileA(path, GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  BYTE *image = nullptr;
+  LARGE_INTEGER file_size;
+  if (GetFileSizeEx(file, &file_size) != FALSE && file_size.QuadPart > 0 &&
+      file_size.QuadPart <= max_bytes) {
+    const DWORD length = (DWORD)file_size.QuadPart;
+    DWORD bytes_read = 0;
+    image = malloc(length);
+    if (image != nullptr &&
+        (ReadFile(file, image, length, &bytes_read, nullptr) == FALSE ||
+         bytes_read != length)) {
+      free(image);
+      image = nullptr;
+    }
+    *size = length;
+  }
+
+  CloseHandle(file);
+  return image;
+}
+
+// ============================================================
+// THREAD SCHEDULING (MMCSS, affinity, EcoQoS)
+// ============================================================
+// MMCSS lifts a registered thread into the real-time range whenever it is
+// runnable, so a build pegging every core can't push clicks into clumps.
+// Blocked threads cost nothing either way, and idle stays idle.
+static atomic_flag scheduling_warned = ATOMIC_FLAG_INIT;
+
+static void WarnSchedulingOnce(const char *what) {
+  if (!atomic_flag_test_and_set(&scheduling_warned)) {
+    DaemonLog("%s failed (Error %lu); running at normal scheduling\n", what,
+              GetLastError());
+  }
+}
+
+// For the calling thread, which keeps the settings until it exits
+static void TuneLatencyThread(AVRT_PRIORITY priority) {
+  if (scheduling_config.affinity != 0 &&
+      SetThreadAffinityMask(GetCurrentThread(),
+                            (DWORD_PTR)scheduling_config.affinity) == 0) {
+    WarnSchedulingOnce("SetThreadAffinityMask");
+  }
+  if (!scheduling_config.mmcss)
+    return;
+  DWORD task_index = 0;
+  HANDLE task = AvSetMmThreadCharacteristicsW(MMCSS_TASK_NAME, &task_index);
+  if (task == nullptr) {
+    WarnSchedulingOnce("MMCSS registration");
+    return;
+  }
+  (void)AvSetMmThreadPriority(task, priority);
+}
+
+// Windows 11 runs background processes like this one on efficiency cores
+// at reduced clocks (EcoQoS). Opting out is per process, so the library
+// leaves its host's choice alone.
+static void ApplyProcessQos(void) {
+  if (scheduling_config.allow_ecoqos)
+    return;
+  PROCESS_POWER_THROTTLING_STATE state = {
+      .Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION,
+      .ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED,
+      .StateMask = 0, // Controlled, and off
+  };
+  // Fails quietly before Windows 10 1709, which has no EcoQoS to avoid
+  (void)SetProcessInformation(GetCurrentProcess(), ProcessPowerThrottling,
+                              &state, sizeof(state));
+}
+
+// ============================================================
+// HEAP TRAP (CLICKER_TRAP_HEAP builds on the debug CRT)
+// ============================================================
+// The debug CRT reports every malloc, calloc and realloc here before it
+// happens, ours and the CRT's own, so nothing on the hot path slips by.
+#if defined(CLICKER_TRAP_HEAP) && defined(_DEBUG)
+static int __cdecl TrapHotPathAllocation(
+    int type, [[maybe_unused]] void *block, [[maybe_unused]] size_t bytes,
+    [[maybe_unused]] int block_type, [[maybe_unused]] long request,
+    [[maybe_unused]] const unsigned char *file, [[maybe_unused]] int line) {
+  if (type != _HOOK_FREE && OnHotPath()) {
+    __builtin_trap();
+  }
+  return TRUE;
+}
+#endif
+
+static void InstallHeapTrap(void) {
+#if defined(CLICKER_TRAP_HEAP) && defined(_DEBUG)
+  (void)_CrtSetAllocHook(TrapHotPathAllocation);
+  DaemonLog("Heap trap armed on the event -> audio path\n");
+#elif defined(CLICKER_TRAP_HEAP)
+  DaemonLog("Heap trap needs the debug CRT; only the arena is checked\n");
+#endif
+}
+
+// ============================================================
+// WINDOW ENUMERATION CALLBACK
+// ============================================================
+static BOOL CALLBACK FindTerminalWindowProc(HWND hwnd, LPARAM l_param) {
+  WindowSearchParams *params = (WindowSearchParams *)(void *)l_param;
+
+  DWORD window_pid = 0;
+  GetWindowThreadProcessId(hwnd, &window_pid);
+
+  // Filter by PID and Visibility
+  if (window_pid == params->target_pid && IsWindowVisible(hwnd) != FALSE) {
+    RECT rect;
+    if (GetWindowRect(hwnd, &rect) != FALSE) {
+      long width = rect.right - rect.left;
+      long height = rect.bottom - rect.top;
+      long area = width * height;
+
+      // The actual terminal frame is always the largest visible window
+      // belonging to the process. We ignore tiny utility windows.
+      if (area > params->max_area && width > MIN_WINDOW_DIMENSION) {
+        params->max_area = area;
+        params->best_hwnd = hwnd;
+      }
+    }
+  }
+  return TRUE; // Continue searching all windows
+}
+
+// ============================================================
+// WINDOW MANIPULATION (The Earthquake)
+// ============================================================
+// Counts the requests that were waiting (all of them are consumed)
+[[nodiscard]]
+static EffectCounts TakeEffectRequests(void) {
+  EffectCounts counts = {0};
+  EffectRequest request;
+  while (EffectRingPop(&effect_queue, &request)) {
+    if (request.kind == EFFECT_SHAKE) {
+      counts.shakes++;
+      counts.shake_target = request.target;
+    } else if (request.kind == EFFECT_FLASH) {
+      counts.flashes++;
+      counts.flash_target = request.target;
+    }
+  }
+  return counts;
+}
+
+[[nodiscard]]
+static TerminalCacheEntry *FindCacheEntry(DWORD pid) {
+  for (int i = 0; i < TERMINAL_CACHE_SIZE; i++) {
+    if (terminal_cache[i].pid == pid)
+      return &terminal_cache[i];
+  }
+  return nullptr;
+}
+
+// Hook callbacks are delivered on the effects worker (it pumps messages)
+static void CALLBACK OnTerminalWinEvent(
+    [[maybe_unused]] HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG object_id,
+    LONG child_id, [[maybe_unused]] DWORD event_thread,
+    [[maybe_unused]] DWORD event_time) {
+  if (hwnd == nullptr || object_id != OBJID_WINDOW || child_id != CHILDID_SELF)
+    return;
+
+  if (event == EVENT_OBJECT_DESTROY) {
+    for (int i = 0; i < TERMINAL_CACHE_SIZE; i++) {
+      if (terminal_cache[i].hwnd == hwnd) {
+        terminal_cache[i].hwnd = nullptr;
+      }
+    }
+    return;
+  }
+
+  // EVENT_SYSTEM_FOREGROUND: a new sizeable window of a cached process may
+  // now be the largest one, so let the next shake rescan that PID
+  DWORD pid = 0;
+  GetWindowThreadProcessId(hwnd, &pid);
+  TerminalCacheEntry *entry = FindCacheEntry(pid);
+  RECT rect;
+  if (entry != nullptr && entry->hwnd != hwnd &&
+      GetWindowRect(hwnd, &rect) != FALSE &&
+      rect.right - rect.left > MIN_WINDOW_DIMENSION) {
+    entry->hwnd = nullptr;
+  }
+}
+
+static void InstallForegroundHook(void) {
+  (void)SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+                        nullptr, OnTerminalWinEvent, 0, 0,
+                        WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+}
+
+[[nodiscard]]
+static HWND ScanTerminalWindow(DWORD pid) {
+  // Search for the largest window owned by the process
+  WindowSearchParams params = {
+      .target_pid = pid, .best_hwnd = nullptr, .max_area = 0};
+  EnumWindows(FindTerminalWindowProc, (LPARAM)(void *)&params);
+  return params.best_hwnd;
+}
+
+// O(1) in steady state; EnumWindows only runs after a real change
+[[nodiscard]]
+static HWND ResolveTerminalWindow(DWORD pid) {
+  TerminalCacheEntry *entry = FindCacheEntry(pid);
+  if (entry != nullptr && entry->hwnd != nullptr &&
+      IsWindowVisible(entry->hwnd) != FALSE)
+    return entry->hwnd;
+
+  const HWND hwnd = ScanTerminalWindow(pid);
+  if (hwnd == nullptr)
+    return nullptr;
+
+  if (entry == nullptr) {
+    entry = &terminal_cache[terminal_cache_next];
+    terminal_cache_next = (terminal_cache_next + 1) % TERMINAL_CACHE_SIZE;
+    if (entry->destroy_hook != nullptr) {
+      UnhookWinEvent(entry->destroy_hook);
+    }
+    *entry = (TerminalCacheEntry){
+        .pid = pid,
+        .destroy_hook = SetWinEventHook(
+            EVENT_OBJECT_DESTROY, EVENT_OBJECT_DESTROY, nullptr,
+            OnTerminalWinEvent, pid, 0, WINEVENT_OUTOFCONTEXT)};
+  }
+  entry->hwnd = hwnd;
+  return hwnd;
+}
+
+[[nodiscard]]
+static LONGLONG CompositorFrameHns(void) {
+  DWM_TIMING_INFO timing = {.cbSize = sizeof(timing)};
+  double refresh_hz = FALLBACK_REFRESH_HZ;
+  if (SUCCEEDED(DwmGetCompositionTimingInfo(nullptr, &timing)) &&
+      timing.rateRefresh.uiDenominator != 0 &&
+      timing.rateRefresh.uiNumerator != 0) {
+    refresh_hz = (double)timing.rateRefresh.uiNumerator /
+                 (double)timing.rateRefresh.uiDenominator;
+  }
+  return (LONGLONG)(10000000.0 / refresh_hz);
+}
+
+static void OpenFramePacer(FramePacer *pacer) {
+  pacer->timer = CreateWaitableTimerExW(nullptr, nullptr,
+                                        CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                        TIMER_ALL_ACCESS);
+  if (pacer->timer == nullptr) {
+    // Pre-1803 kernels: a plain timer still beats Sleep's drift
+    pacer->timer =
+        CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+  }
+  pacer->frame_hns = CompositorFrameHns();
+}
+
+static void WaitNextFrame(const FramePacer *pacer) {
+  if (SUCCEEDED(DwmFlush()))
+    return;
+
+  if (pacer->timer != nullptr) {
+    const LARGE_INTEGER due = {.QuadPart = -pacer->frame_hns}; // Relative
+    if (SetWaitableTimer(pacer->timer, &due, 0, nullptr, nullptr, FALSE) !=
+        FALSE) {
+      WaitForSingleObject(pacer->timer, INFINITE);
+      return;
+    }
+  }
+  Sleep((DWORD)(pacer->frame_hns / 10000)); // Last resort
+}
+
+// Damped sine: A * e^(-decay * t/T) * sin(2*pi*f*t)
+[[nodiscard]]
+static int ShakeOffset(int64_t elapsed_ticks, double amplitude_px) {
+  const double t = (double)elapsed_ticks / (double)qpc_ticks_per_second;
+  const double progress = t * 1000.0 / shake_config.duration_ms;
+  const double envelope = exp(-SHAKE_DECAY * progress);
+  return (int)lround(amplitude_px * envelope *
+                     sin(TWO_PI * SHAKE_FREQUENCY_HZ * t));
+}
+
+// --shake-px is in 96-DPI pixels, so a 150% monitor moves 1.5x as far and
+// the shake looks the same size wherever the window is
+[[nodiscard]]
+static double ScaledAmplitude(HWND hwnd) {
+  const UINT dpi =
+      get_dpi_for_window != nullptr ? get_dpi_for_window(hwnd) : 0;
+  const double scale = dpi != 0 ? (double)dpi / USER_DEFAULT_SCREEN_DPI : 1.0;
+  return shake_config.amplitude_px * scale;
+}
+
+// Per-monitor coordinates for this thread only, so GetWindowRect and the
+// moves are physical pixels on every monitor (the host of the library
+// keeps whatever awareness it chose)
+static void AdoptPerMonitorDpi(void) {
+  HMODULE user32 = GetModuleHandleA("user32.dll");
+  if (user32 == nullptr)
+    return;
+  SetThreadDpiAwarenessContextFn set_awareness =
+      (SetThreadDpiAwarenessContextFn)(void *)GetProcAddress(
+          user32, "SetThreadDpiAwarenessContext");
+  if (set_awareness == nullptr ||
+      set_awareness(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2) == nullptr)
+    return;
+  get_dpi_for_window =
+      (GetDpiForWindowFn)(void *)GetProcAddress(user32, "GetDpiForWindow");
+}
+
+// One-window DeferWindowPos batch: the move is applied atomically by the
+// window manager, and only the position changes (no size, z-order, focus).
+static void MoveWindowDeferred(HWND hwnd, int x, int y) {
+  HDWP batch = BeginDeferWindowPos(1);
+  if (batch != nullptr) {
+    batch = DeferWindowPos(batch, hwnd, nullptr, x, y, 0, 0,
+                           SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+  }
+  if (batch == nullptr || EndDeferWindowPos(batch) == FALSE) {
+    SetWindowPos(hwnd, nullptr, x, y, 0, 0,
+                 SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+  }
+}
+
+[[nodiscard]]
+static HWND ForegroundTerminalWindow(void) {
+  HWND active_hwnd = GetForegroundWindow();
+  if (active_hwnd == nullptr)
+    return nullptr;
+
+  DWORD current_pid = 0;
+  GetWindowThreadProcessId(active_hwnd, &current_pid);
+  return ResolveTerminalWindow(current_pid);
+}
+
+// The client's console window leads straight to its terminal: conhost
+// owns it, and Windows Terminal's pseudo-console window is owned by the
+// tab's frame. Only clients that sent no window pay for a lookup.
+[[nodiscard]]
+static HWND ResolveEffectWindow(const EffectTarget *target) {
+  if (target->window != 0) {
+    HWND hwnd = (HWND)(uintptr_t)target->window;
+    HWND frame = IsWindow(hwnd) != FALSE ? GetAncestor(hwnd, GA_ROOTOWNER)
+                                         : nullptr;
+    if (frame != nullptr && IsWindowVisible(frame) != FALSE)
+      return frame;
+  } else if (target->pid != 0) {
+    HWND hwnd = ResolveTerminalWindow(target->pid); // GUI clients
+    if (hwnd != nullptr)
+      return hwnd;
+  }
+  return ForegroundTerminalWindow();
+}
+
+// One caption blink; the window manager times it, so nothing waits here
+static void FlashWindowsTerminal(const EffectTarget *target) {
+  HWND terminal_hwnd = ResolveEffectWindow(target);
+  if (terminal_hwnd == nullptr)
+    return;
+
+  FLASHWINFO flash = {
+      .cbSize = sizeof(flash),
+      .hwnd = terminal_hwnd,
+      .dwFlags = FLASHW_CAPTION,
+      .uCount = 1,
+  };
+  FlashWindowEx(&flash);
+}
+
+// Drives `hwnd` through the damped sine around `rect` and puts it back
+static void AnimateShake(HWND hwnd, const RECT *rect, double amplitude_px) {
+  const int64_t duration =
+      (int64_t)shake_config.duration_ms * qpc_ticks_per_second / 1000;
+  int64_t start = PlatformNowTicks();
+  int restarts = 0;
+
+  for (int64_t elapsed = 0; elapsed < duration;
+       elapsed = PlatformNowTicks() - start) {
+    MoveWindowDeferred(hwnd, rect->left + ShakeOffset(elapsed, amplitude_px),
+                       rect->top);
+    WaitNextFrame(&frame_pacer);
+
+    // Another save mid-shake restarts the animation from the original
+    // rect instead of being dropped (or stacking a second thread), even
+    // one aimed at another window: this one has to settle first anyway
+    const EffectCounts requests = TakeEffectRequests();
+    if (requests.flashes > 0) {
+      FlashWindowsTerminal(&requests.flash_target);
+    }
+    if (requests.shakes > 0 && restarts < SHAKE_MAX_RESTARTS) {
+      restarts++;
+      start = PlatformNowTicks();
+    }
+  }
+
+  // Final snap back to the exact original coordinates
+  MoveWindowDeferred(hwnd, rect->left, rect->top);
+}
+
+// ============================================================
+// SNAPSHOT OVERLAY (--shake-style overlay, effects worker only)
+// ============================================================
+// A copy of the terminal's pixels goes into a click-through layered popup
+// and that popup is what shakes. DWM only re-places a surface it already
+// has, and the terminal itself never moves, so it never relays out and
+// keeps taking keys. Output arriving meanwhile shows once the popup is gone.
+
+// Registered against whichever module we are (daemon or clicker_core)
+[[nodiscard]]
+static HINSTANCE OwnModule(void) {
+  HMODULE module = nullptr;
+  (void)GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                               GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           (LPCSTR)(void *)OwnModule, &module);
+  return module;
+}
+
+[[nodiscard]]
+static bool RegisterOverlayClass(void) {
+  if (overlay_class == 0) {
+    const WNDCLASSEXA window_class = {
+        .cbSize = sizeof(window_class),
+        .lpfnWndProc = DefWindowProcA,
+        .hInstance = OwnModule(),
+        .lpszClassName = OVERLAY_CLASS_NAME,
+    };
+    overlay_class = RegisterClassExA(&window_class);
+  }
+  return overlay_class != 0;
+}
+
+// GetWindowRect includes the invisible resize borders around the frame.
+// DWM reports the drawn bounds in physical pixels, which only match our
+// coordinates once the worker is per-monitor aware.
+[[nodiscard]]
+static RECT VisibleFrame(HWND hwnd, RECT rect) {
+  RECT bounds;
+  if (get_dpi_for_window != nullptr &&
+      SUCCEEDED(DwmGetWindowAttribute(hwnd, DWMWA_EXTENDED_FRAME_BOUNDS,
+                                      &bounds, sizeof(bounds))))
+    return bounds;
+  return rect;
+}
+
+static void ReleaseSnapshot(Snapshot *shot) {
+  if (shot->previous != nullptr) {
+    SelectObject(shot->dc, shot->previous);
+  }
+  if (shot->bitmap != nullptr) {
+    DeleteObject(shot->bitmap);
+  }
+  if (shot->dc != nullptr) {
+    DeleteDC(shot->dc);
+  }
+  *shot = (Snapshot){0};
+}
+
+// What is on screen, whatever renders it: Windows Terminal draws with
+// DirectX, which PrintWindow can only reproduce slowly, if at all
+[[nodiscard]]
+static bool CaptureSnapshot(Snapshot *shot, const RECT *frame) {
+  const int width = frame->right - frame->left;
+  const int height = frame->bottom - frame->top;
+  HDC screen = GetDC(nullptr);
+  if (screen == nullptr)
+    return false;
+
+  shot->dc = CreateCompatibleDC(screen);
+  shot->bitmap = CreateCompatibleBitmap(screen, width, height);
+  bool captured = shot->dc != nullptr && shot->bitmap != nullptr;
+  if (captured) {
+    shot->previous = SelectObject(shot->dc, shot->bitmap);
+    captured = BitBlt(shot->dc, 0, 0, width, height, screen, frame->left,
+                      frame->top, SRCCOPY) != FALSE;
+  }
+  ReleaseDC(nullptr, screen);
+  if (!captured) {
+    ReleaseSnapshot(shot);
+  }
+  return captured;
+}
+
+// False when the overlay couldn't be made; the caller moves the real
+// window instead
+[[nodiscard]]
+static bool ShakeOverlay(HWND terminal_hwnd, const RECT *rect,
+                         double amplitude_px) {
+  const RECT frame = VisibleFrame(terminal_hwnd, *rect);
+  Snapshot shot = {0};
+  if (!RegisterOverlayClass() || !CaptureSnapshot(&shot, &frame))
+    return false;
+
+  POINT origin = {frame.left, frame.top};
+  SIZE size = {frame.right - frame.left, frame.bottom - frame.top};
+  POINT source = {0, 0};
+  HWND overlay = CreateWindowExA(
+      WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOOLWINDOW |
+          WS_EX_NOACTIVATE | WS_EX_TOPMOST,
+      OVERLAY_CLASS_NAME, "", WS_POPUP, origin.x, origin.y, size.cx, size.cy,
+      nullptr, nullptr, OwnModule(), nullptr);
+  const bool shown =
+      overlay != nullptr &&
+      UpdateLayeredWindow(overlay, nullptr, &origin, &size, shot.dc, &source,
+                          0, nullptr, ULW_OPAQUE) != FALSE;
+  if (shown) {
+    ShowWindow(overlay, SW_SHOWNOACTIVATE);
+    AnimateShake(overlay, &frame, amplitude_px);
+  }
+
+  if (overlay != nullptr) {
+    DestroyWindow(overlay);
+  }
+  ReleaseSnapshot(&shot);
+  return shown;
+}
+
+static void ShakeWindowsTerminal(const EffectTarget *target) {
+  HWND terminal_hwnd = ResolveEffectWindow(target);
+  if (terminal_hwnd == nullptr)
+    return;
+
+  RECT rect;
+  if (GetWindowRect(terminal_hwnd, &rect) == FALSE)
+    return;
+  const double amplitude_px = ScaledAmplitude(terminal_hwnd);
+
+  // A snapshot can shake even a maximized terminal
+  if (shake_config.style == SHAKE_STYLE_OVERLAY &&
+      ShakeOverlay(terminal_hwnd, &rect, amplitude_px))
+    return;
+  if (IsZoomed(terminal_hwnd) != FALSE)
+    return;
+  AnimateShake(terminal_hwnd, &rect, amplitude_px);
+}
+
+// Delivers queued WinEvent callbacks (and anything else posted to us)
+static void PumpWorkerMessages(void) {
+  MSG msg;
+  while (PeekMessageA(&msg, nullptr, 0, 0, PM_REMOVE) != FALSE) {
+    DispatchMessageA(&msg);
+  }
+}
+
+static DWORD WINAPI EffectsWorkerThread([[maybe_unused]] LPVOID parameter) {
+  InstallForegroundHook(); // Hooks belong to the thread that installs them
+  AdoptPerMonitorDpi();
+  OpenFramePacer(&frame_pacer);
+
+  while (true) {
+    const DWORD wait = MsgWaitForMultipleObjectsEx(
+        1, &effect_wake_event, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+    if (wait == WAIT_OBJECT_0) {
+      PumpWorkerMessages(); // Invalidate before we trust the cache
+      const EffectCounts requests = TakeEffectRequests();
+      if (requests.flashes > 0) {
+        FlashWindowsTerminal(&requests.flash_target);
+      }
+      if (requests.shakes > 0) {
+        ShakeWindowsTerminal(&requests.shake_target);
+      }
+    } else if (wait == WAIT_OBJECT_0 + 1) {
+      PumpWorkerMessages();
+    } else {
+      return 1;
+    }
+  }
+}
+
+static BOOL CALLBACK StartEffectsWorkerOnce([[maybe_unused]] PINIT_ONCE once,
+                                            [[maybe_unused]] PVOID parameter,
+                                            [[maybe_unused]] PVOID *context) {
+  EffectRingInit(&effect_queue);
+  effect_wake_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  if (effect_wake_event == nullptr)
+    return TRUE;
+
+  HANDLE thread_handle =
+      CreateThread(nullptr, 0, EffectsWorkerThread, nullptr, 0, nullptr);
+  if (thread_handle != nullptr) {
+    CloseHandle(thread_handle); // Lives for the whole daemon lifetime
+  }
+  return TRUE;
+}
+
+// user32 and DWM stay unloaded until the first shake actually needs them
+static void EnsureEffectsWorker(void) {
+  InitOnceExecuteOnce(&effects_worker_once, StartEffectsWorkerOnce, nullptr,
+                      nullptr);
+}
+
+static void RequestEffect(EffectKind kind, const EffectTarget *target) {
+  EnsureEffectsWorker();
+  const EffectRequest request = {.kind = (uint8_t)kind, .target = *target};
+  if (effect_wake_event != nullptr &&
+      EffectRingPush(&effect_queue, request)) {
+    SetEvent(effect_wake_event);
+  }
+}
+
+// Called from any pipe worker; never blocks and never creates a thread
+void PlatformShake(const EffectTarget *target) {
+  RequestEffect(EFFECT_SHAKE, target);
+}
+
+void PlatformFlash(const EffectTarget *target) {
+  RequestEffect(EFFECT_FLASH, target);
+}
+
+uint64_t PlatformConsoleWindow(void) {
+  return (uint64_t)(uintptr_t)GetConsoleWindow();
+}
+
+// ============================================================
+// SOUND BANK WATCH (ReadDirectoryChangesW on the completion port)
+// ============================================================
+static void ReloadSoundsLocked(bool force) {
+  AcquireSRWLockExclusive(&sound_bank_lock);
+  ReloadSoundBank(force);
+  ReleaseSRWLockExclusive(&sound_bank_lock);
+}
+
+static void BeginSoundWatch(void) {
+  sound_watch.overlapped = (OVERLAPPED){0};
+  if (ReadDirectoryChangesW(
+          sound_watch.directory, sound_watch.changes,
+          sizeof(sound_watch.changes), FALSE,
+          FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+          nullptr, &sound_watch.overlapped, nullptr) == FALSE) {
+    DaemonLog("Stopped watching %s (Error %lu)\n", SOUNDS_DIR,
+              GetLastError());
+  }
+}
+
+// A zero-byte completion means the change buffer overflowed; the full
+// rescan below covers that case too.
+static void OnSoundWatchCompletion(BOOL ok) {
+  if (ok == FALSE) {
+    DaemonLog("Stopped watching %s (Error %lu)\n", SOUNDS_DIR,
+              GetLastError());
+    return;
+  }
+  ReloadSoundsLocked(false);
+  BeginSoundWatch();
+}
+
+void PlatformRequestReload(void) {
+  PostQueuedCompletionStatus(completion_port, 0, COMPLETION_RELOAD, nullptr);
+}
+
+// Queues the first load on the completion port instead of doing it here,
+// so the event that woke the audio engine isn't kept waiting on disk I/O.
+static void StartSoundWatcher(void) {
+  PlatformRequestReload();
+
+  sound_watch.directory = CreateFileA(
+      SOUNDS_DIR, FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+      nullptr);
+  if (sound_watch.directory == INVALID_HANDLE_VALUE)
+    return; // No sounds/ at all: the synth covers every slot
+
+  if (CreateIoCompletionPort(sound_watch.directory, completion_port,
+                             COMPLETION_SOUNDS, 0) == nullptr) {
+    CloseHandle(sound_watch.directory);
+    sound_watch.directory = INVALID_HANDLE_VALUE;
+    return;
+  }
+  BeginSoundWatch();
+}
+
+// ============================================================
+// WASAPI DEVICE (Event-driven, shared or exclusive)
+// ============================================================
+// Maps the stereo mix onto the device layout: L/R to the first two
+// channels (or averaged on mono endpoints), silence everywhere else.
+static void WriteDeviceSamples(const AudioDevice *device, BYTE *out,
+                               UINT32 frames) {
+  const WORD channels = device->channels;
+  for (UINT32 f = 0; f < frames; f++) {
+    const float left = ClampSample(device->mix[f * MIX_CHANNELS]);
+    const float right = ClampSample(device->mix[(f * MIX_CHANNELS) + 1]);
+
+    for (WORD c = 0; c < channels; c++) {
+      float value = 0.0f;
+      if (channels == 1) {
+        value = (left + right) * 0.5f;
+      } else if (c < MIX_CHANNELS) {
+        value = (c == 0) ? left : right;
+      }
+
+      const size_t index = ((size_t)f * channels) + c;
+      switch (device->sample_format) {
+      case SAMPLE_FORMAT_FLOAT32:
+        ((float *)(void *)out)[index] = value;
+        break;
+      case SAMPLE_FORMAT_INT16:
+        ((int16_t *)(void *)out)[index] = (int16_t)(value * 32767.0f);
+        break;
+      case SAMPLE_FORMAT_INT32:
+        ((int32_t *)(void *)out)[index] =
+            (int32_t)((double)value * 2147483647.0);
+        break;
+      }
+    }
+  }
+}
+
+[[nodiscard]]
+static bool ResolveSampleFormat(const WAVEFORMATEX *format,
+                                SampleFormat *out) {
+  bool is_float = format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+  bool is_pcm = format->wFormatTag == WAVE_FORMAT_PCM_;
+
+  if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+    const WAVEFORMATEXTENSIBLE *ext =
+        (const WAVEFORMATEXTENSIBLE *)(const void *)format;
+    is_float = IsEqualGUID(&ext->SubFormat, &SUBTYPE_IEEE_FLOAT_) != FALSE;
+    is_pcm = IsEqualGUID(&ext->SubFormat, &SUBTYPE_PCM_) != FALSE;
+  }
+
+  if (is_float && format->wBitsPerSample == 32) {
+    *out = SAMPLE_FORMAT_FLOAT32;
+  } else if (is_pcm && format->wBitsPerSample == 16) {
+    *out = SAMPLE_FORMAT_INT16;
+  } else if (is_pcm && format->wBitsPerSample == 32) {
+    *out = SAMPLE_FORMAT_INT32;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+[[nodiscard]]
+static WAVEFORMATEXTENSIBLE MakeExclusiveFormat(const WAVEFORMATEX *mix_format,
+                                                SampleFormat sample_format) {
+  const WORD bits = (sample_format == SAMPLE_FORMAT_INT16) ? 16 : 32;
+  const WORD block_align = (WORD)(mix_format->nChannels * (bits / 8));
+  WAVEFORMATEXTENSIBLE format = {
+      .Format =
+          {
+              .wFormatTag = WAVE_FORMAT_EXTENSIBLE,
+              .nChannels = mix_format->nChannels,
+              .nSamplesPerSec = mix_format->nSamplesPerSec,
+              .nAvgBytesPerSec = mix_format->nSamplesPerSec * block_align,
+              .nBlockAlign = block_align,
+              .wBitsPerSample = bits,
+              .cbSize = (WORD)(sizeof(WAVEFORMATEXTENSIBLE) -
+                               sizeof(WAVEFORMATEX)),
+          },
+      .Samples = {.wValidBitsPerSample = bits},
+      .SubFormat = (sample_format == SAMPLE_FORMAT_FLOAT32)
+                       ? SUBTYPE_IEEE_FLOAT_
+                       : SUBTYPE_PCM_,
+  };
+
+  // Speaker bits are ordered, so the low N bits are the canonical N-channel
+  // layout whenever the mix format doesn't spell one out
+  format.dwChannelMask =
+      (mix_format->wFormatTag == WAVE_FORMAT_EXTENSIBLE)
+          ? ((const WAVEFORMATEXTENSIBLE *)(const void *)mix_format)
+                ->dwChannelMask
+          : (DWORD)((1u << mix_format->nChannels) - 1u);
+  return format;
+}
+
+[[nodiscard]]
+static HRESULT ActivateAudioClient(IMMDevice *endpoint, IAudioClient **out) {
+  return IMMDevice_Activate(endpoint, &IID_IAudioClient_, CLSCTX_ALL, nullptr,
+                            (void **)out);
+}
+
+// Exclusive mode talks to the driver directly: first format the endpoint
+// accepts wins, then the buffer is re-aligned if the driver demands it.
+[[nodiscard]]
+static HRESULT InitializeExclusive(IMMDevice *endpoint,
+                                   const WAVEFORMATEX *mix_format,
+                                   AudioDevice *device) {
+  static const SampleFormat CANDIDATES[] = {
+      SAMPLE_FORMAT_FLOAT32, SAMPLE_FORMAT_INT32, SAMPLE_FORMAT_INT16};
+
+  REFERENCE_TIME default_period = 0;
+  REFERENCE_TIME min_period = 0;
+  HRESULT hr = IAudioClient_GetDevicePeriod(device->client, &default_period,
+                                           &min_period);
+  if (FAILED(hr))
+    return hr;
+
+  REFERENCE_TIME period =
+      (REFERENCE_TIME)(audio_config.period_ms * HNS_PER_MS);
+  if (period < min_period)
+    period = min_period;
+
+  for (size_t i = 0; i < sizeof(CANDIDATES) / sizeof(CANDIDATES[0]); i++) {
+    WAVEFORMATEXTENSIBLE format =
+        MakeExclusiveFormat(mix_format, CANDIDATES[i]);
+    WAVEFORMATEX *wave = &format.Format;
+
+    if (IAudioClient_IsFormatSupported(device->client,
+                                       AUDCLNT_SHAREMODE_EXCLUSIVE, wave,
+                                       nullptr) != S_OK)
+      continue;
+
+    hr = IAudioClient_Initialize(device->client, AUDCLNT_SHAREMODE_EXCLUSIVE,
+                                 AUDCLNT_STREAMFLAGS_EVENTCALLBACK, period,
+                                 period, wave, nullptr);
+
+    if (hr == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED) {
+      UINT32 aligned_frames = 0;
+      hr = IAudioClient_GetBufferSize(device->client, &aligned_frames);
+      if (FAILED(hr))
+        return hr;
+
+      period = (REFERENCE_TIME)((HNS_PER_MS * 1000.0 * aligned_frames /
+                                 wave->nSamplesPerSec) +
+                                0.5);
+      IAudioClient_Release(device->client);
+      device->client = nullptr;
+      hr = ActivateAudioClient(endpoint, &device->client);
+      if (FAILED(hr))
+        return hr;
+      hr = IAudioClient_Initialize(device->client, AUDCLNT_SHAREMODE_EXCLUSIVE,
+                                   AUDCLNT_STREAMFLAGS_EVENTCALLBACK, period,
+                                   period, wave, nullptr);
+    }
+
+    if (SUCCEEDED(hr)) {
+      device->sample_format = CANDIDATES[i];
+      device->sample_rate = wave->nSamplesPerSec;
+      device->channels = wave->nChannels;
+      device->exclusive = true;
+    }
+    return hr;
+  }
+  return AUDCLNT_E_UNSUPPORTED_FORMAT;
+}
+
+// Shared mode goes through the engine mixer. IAudioClient3 (Windows 10+)
+// lets us ask for a smaller engine period than the 10 ms default.
+[[nodiscard]]
+static HRESULT InitializeShared(const WAVEFORMATEX *mix_format,
+                                AudioDevice *device) {
+  if (!ResolveSampleFormat(mix_format, &device->sample_format))
+    return AUDCLNT_E_UNSUPPORTED_FORMAT;
+
+  device->sample_rate = mix_format->nSamplesPerSec;
+  device->channels = mix_format->nChannels;
+  device->exclusive = false;
+
+  IAudioClient3 *client3 = nullptr;
+  HRESULT hr = IAudioClient_QueryInterface(device->client, &IID_IAudioClient3_,
+                                           (void **)&client3);
+  if (SUCCEEDED(hr)) {
+    UINT32 default_frames = 0;
+    UINT32 fundamental_frames = 0;
+    UINT32 min_frames = 0;
+    UINT32 max_frames = 0;
+    hr = IAudioClient3_GetSharedModeEnginePeriod(
+        client3, mix_format, &default_frames, &fundamental_frames, &min_frames,
+        &max_frames);
+
+    if (SUCCEEDED(hr) && fundamental_frames > 0) {
+      UINT32 frames = (UINT32)(audio_config.period_ms *
+                               mix_format->nSamplesPerSec / 1000.0);
+      frames = ((frames + fundamental_frames - 1) / fundamental_frames) *
+               fundamental_frames;
+      if (frames < min_frames) {
+        frames = min_frames;
+      } else if (frames > max_frames) {
+        frames = max_frames;
+      }
+      hr = IAudioClient3_InitializeSharedAudioStream(
+          client3, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, frames, mix_format,
+          nullptr);
+    }
+    IAudioClient3_Release(client3);
+    if (SUCCEEDED(hr))
+      return hr;
+  }
+
+  // Pre-Windows 10 engines (or drivers without low-latency support)
+  return IAudioClient_Initialize(
+      device->client, AUDCLNT_SHAREMODE_SHARED,
+      AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+      (REFERENCE_TIME)(audio_config.period_ms * HNS_PER_MS), 0, mix_format,
+      nullptr);
+}
+
+static void CloseAudioDevice(AudioDevice *device) {
+  if (device->client != nullptr) {
+    IAudioClient_Stop(device->client);
+  }
+  if (device->render != nullptr) {
+    IAudioRenderClient_Release(device->render);
+  }
+  if (device->client != nullptr) {
+    IAudioClient_Release(device->client);
+  }
+  if (device->ready_event != nullptr) {
+    CloseHandle(device->ready_event);
+  }
+  free(device->mix);
+  *device = (AudioDevice){0};
+}
+
+[[nodiscard]]
+static HRESULT OpenAudioDevice(AudioDevice *device) {
+  IMMDeviceEnumerator *enumerator = nullptr;
+  IMMDevice *endpoint = nullptr;
+  WAVEFORMATEX *mix_format = nullptr;
+
+  HRESULT hr = CoCreateInstance(&CLSID_MMDeviceEnumerator_, nullptr,
+                                CLSCTX_ALL, &IID_IMMDeviceEnumerator_,
+                                (void **)&enumerator);
+  if (SUCCEEDED(hr)) {
+    hr = IMMDeviceEnumerator_GetDefaultAudioEndpoint(enumerator, eRender,
+                                                     eConsole, &endpoint);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = ActivateAudioClient(endpoint, &device->client);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = IAudioClient_GetMixFormat(device->client, &mix_format);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = audio_config.exclusive
+             ? InitializeExclusive(endpoint, mix_format, device)
+             : InitializeShared(mix_format, device);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = IAudioClient_GetBufferSize(device->client, &device->buffer_frames);
+  }
+  if (SUCCEEDED(hr)) {
+    device->ready_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+    hr = (device->ready_event != nullptr)
+             ? IAudioClient_SetEventHandle(device->client, device->ready_event)
+             : HRESULT_FROM_WIN32(GetLastError());
+  }
+  if (SUCCEEDED(hr)) {
+    hr = IAudioClient_GetService(device->client, &IID_IAudioRenderClient_,
+                                 (void **)&device->render);
+  }
+  if (SUCCEEDED(hr)) {
+    device->mix = malloc(sizeof(float) * MIX_CHANNELS * device->buffer_frames);
+    hr = (device->mix != nullptr) ? S_OK : E_OUTOFMEMORY;
+  }
+  if (SUCCEEDED(hr)) {
+    // Hand the engine one period of silence so the first event has data
+    BYTE *data = nullptr;
+    hr = IAudioRenderClient_GetBuffer(device->render, device->buffer_frames,
+                                      &data);
+    if (SUCCEEDED(hr)) {
+      hr = IAudioRenderClient_ReleaseBuffer(
+          device->render, device->buffer_frames, AUDCLNT_BUFFERFLAGS_SILENT);
+    }
+  }
+  if (SUCCEEDED(hr)) {
+    hr = IAudioClient_Start(device->client);
+  }
+
+  CoTaskMemFree(mix_format);
+  if (endpoint != nullptr) {
+    IMMDevice_Release(endpoint);
+  }
+  if (enumerator != nullptr) {
+    IMMDeviceEnumerator_Release(enumerator);
+  }
+  if (FAILED(hr)) {
+    CloseAudioDevice(device);
+  }
+  return hr;
+}
+
+// One device period per wake-up. Returns the HRESULT that ended the stream
+// (usually AUDCLNT_E_DEVICE_INVALIDATED when the endpoint goes away),
+// AUDIO_DEVICE_CHANGED when the default endpoint moved elsewhere, or
+// AUDIO_IDLE once nothing has played for --park-after.
+[[nodiscard]]
+static HRESULT RunAudioDevice(AudioDevice *device) {
+  const HANDLE waits[] = {device->ready_event, audio_device_event};
+  while (true) {
+    const DWORD signaled =
+        WaitForMultipleObjects(2, waits, FALSE, AUDIO_EVENT_TIMEOUT_MS);
+    if (signaled == WAIT_OBJECT_0 + 1)
+      return AUDIO_DEVICE_CHANGED;
+    if (signaled != WAIT_OBJECT_0)
+      return AUDCLNT_E_DEVICE_INVALIDATED; // The engine stopped signalling us
+
+    UINT32 frames = device->buffer_frames;
+    if (!device->exclusive) {
+      UINT32 padding = 0;
+      const HRESULT hr =
+          IAudioClient_GetCurrentPadding(device->client, &padding);
+      if (FAILED(hr))
+        return hr;
+      frames -= padding;
+    }
+
+    if (frames == 0)
+      continue; // Shared mode with a full buffer: nothing to render yet
+
+    // Every exit after Begin goes through End, which leaves the hot path
+    BeginAudioPeriod(device->sample_rate);
+    BYTE *data = nullptr;
+    HRESULT hr = IAudioRenderClient_GetBuffer(device->render, frames, &data);
+    if (SUCCEEDED(hr)) {
+      DWORD flags = 0;
+      if (MixVoices(device->mix, frames)) {
+        WriteDeviceSamples(device, data, frames);
+      } else {
+        flags = AUDCLNT_BUFFERFLAGS_SILENT;
+      }
+      hr = IAudioRenderClient_ReleaseBuffer(device->render, frames, flags);
+    }
+    EndAudioPeriod();
+    if (FAILED(hr))
+      return hr;
+    if (AudioWantsPark())
+      return AUDIO_IDLE;
+  }
+}
+
+// Endpoint notifications arrive on an MMDevice thread; all we do there is
+// wake the render thread. The object is static, so refcounting is a no-op.
+static HRESULT STDMETHODCALLTYPE
+NotifierQueryInterface(IMMNotificationClient *self, REFIID riid,
+                       void **out) {
+  if (IsEqualIID(riid, &IID_IUnknown_) ||
+      IsEqualIID(riid, &IID_IMMNotificationClient_)) {
+    *out = self;
+    return S_OK;
+  }
+  *out = nullptr;
+  return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE
+NotifierAddRef([[maybe_unused]] IMMNotificationClient *self) {
+  return 1;
+}
+
+static ULONG STDMETHODCALLTYPE
+NotifierRelease([[maybe_unused]] IMMNotificationClient *self) {
+  return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE
+NotifierDeviceStateChanged([[maybe_unused]] IMMNotificationClient *self,
+                           [[maybe_unused]] LPCWSTR device_id,
+                           [[maybe_unused]] DWORD new_state) {
+  SetEvent(audio_device_event);
+  return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE
+NotifierDeviceAdded([[maybe_unused]] IMMNotificationClient *self,
+                    [[maybe_unused]] LPCWSTR device_id) {
+  SetEvent(audio_device_event);
+  return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE
+NotifierDeviceRemoved([[maybe_unused]] IMMNotificationClient *self,
+                      [[maybe_unused]] LPCWSTR device_id) {
+  return S_OK; // Losing the open endpoint invalidates the stream anyway
+}
+
+static HRESULT STDMETHODCALLTYPE
+NotifierDefaultDeviceChanged([[maybe_unused]] IMMNotificationClient *self,
+                             EDataFlow flow, ERole role,
+                             [[maybe_unused]] LPCWSTR device_id) {
+  if (flow == eRender && role == eConsole) {
+    SetEvent(audio_device_event);
+  }
+  return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE
+NotifierPropertyValueChanged([[maybe_unused]] IMMNotificationClient *self,
+                             [[maybe_unused]] LPCWSTR device_id,
+                             [[maybe_unused]] const PROPERTYKEY key) {
+  return S_OK;
+}
+
+static IMMNotificationClientVtbl device_notifier_vtable = {
+    .QueryInterface = NotifierQueryInterface,
+    .AddRef = NotifierAddRef,
+    .Release = NotifierRelease,
+    .OnDeviceStateChanged = NotifierDeviceStateChanged,
+    .OnDeviceAdded = NotifierDeviceAdded,
+    .OnDeviceRemoved = NotifierDeviceRemoved,
+    .OnDefaultDeviceChanged = NotifierDefaultDeviceChanged,
+    .OnPropertyValueChanged = NotifierPropertyValueChanged,
+};
+static IMMNotificationClient device_notifier = {
+    .lpVtbl = &device_notifier_vtable};
+
+// Keeps an enumerator alive for the thread's lifetime so endpoint changes
+// wake us instead of a polling loop. Returns nullptr if that's unavailable.
+[[nodiscard]]
+static IMMDeviceEnumerator *WatchAudioEndpoints(void) {
+  IMMDeviceEnumerator *enumerator = nullptr;
+  if (FAILED(CoCreateInstance(&CLSID_MMDeviceEnumerator_, nullptr, CLSCTX_ALL,
+                              &IID_IMMDeviceEnumerator_,
+                              (void **)&enumerator)))
+    return nullptr;
+
+  if (FAILED(IMMDeviceEnumerator_RegisterEndpointNotificationCallback(
+          enumerator, &device_notifier))) {
+    IMMDeviceEnumerator_Release(enumerator);
+    return nullptr;
+  }
+  return enumerator;
+}
+
+// The stream is already closed, so the endpoint is free to power down.
+// The daemon also hands its pages back; nothing of ours runs until the
+// next event, and UnparkAudio faults the ones that matter back in.
+static void ParkRenderThread(void) {
+  if (!ParkAudio())
+    return; // A trigger raced the park; reopen for it right away
+
+  DaemonLog("Audio: silent for %u s; stream released until the next event\n",
+            (unsigned)(audio_config.park_after_ms / 1000));
+  if (daemon_mode) {
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+  }
+  WaitForSingleObject(audio_wake_event, INFINITE);
+  ResetEvent(audio_device_event); // The reopen picks the current default
+}
+
+void PlatformWakeAudio(void) {
+  SetEvent(audio_wake_event);
+}
+
+static DWORD WINAPI AudioRenderThread([[maybe_unused]] LPVOID parameter) {
+  TuneLatencyThread(AVRT_PRIORITY_HIGH);
+  audio_device_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  audio_wake_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  if (audio_device_event == nullptr || audio_wake_event == nullptr ||
+      FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+    return 1;
+
+  // Never released: the notifier must outlive every stream we open
+  [[maybe_unused]] IMMDeviceEnumerator *endpoint_watch = WatchAudioEndpoints();
+  AudioDevice device = {0};
+  bool reopening = false;
+  bool waking = false; // Back from a park: queued triggers are fresh
+  while (true) {
+    HRESULT hr = OpenAudioDevice(&device);
+    if (SUCCEEDED(hr)) {
+      DaemonLog("Audio: %s mode, %u Hz, %u-frame buffer (%.2f ms)\n",
+                device.exclusive ? "exclusive" : "shared",
+                device.sample_rate, device.buffer_frames,
+                1000.0 * device.buffer_frames / device.sample_rate);
+
+      if (waking) {
+        UnparkAudio();
+      } else if (reopening) {
+        DiscardQueuedTriggers();
+      }
+      waking = false;
+      hr = RunAudioDevice(&device);
+      CloseAudioDevice(&device);
+      SilenceVoices();
+    }
+
+    reopening = true;
+    if (hr == AUDIO_IDLE) {
+      ParkRenderThread();
+      waking = true;
+      continue;
+    }
+    if (hr == AUDIO_DEVICE_CHANGED) {
+      DaemonLog("Default audio device changed; reopening\n");
+      continue;
+    }
+    // Wakes early when an endpoint appears or becomes the default. The
+    // timeout only matters while a device exists but refuses us (e.g. an
+    // exclusive-mode owner), and nothing here runs once a stream is open.
+    DaemonLog("Audio device unavailable (0x%08lX). Retrying in %u ms or "
+              "on the next device change...\n",
+              (unsigned long)hr, AUDIO_REOPEN_DELAY_MS);
+    WaitForSingleObject(audio_device_event, AUDIO_REOPEN_DELAY_MS);
+  }
+}
+
+// COM, the endpoint and the sound bank all wait for the first event
+void PlatformStartAudio(void) {
+  StartSoundWatcher();
+  HANDLE thread_handle =
+      CreateThread(nullptr, 0, AudioRenderThread, nullptr, 0, nullptr);
+  if (thread_handle != nullptr) {
+    // Where MMCSS is off or refuses us, this is what the thread keeps
+    SetThreadPriority(thread_handle, THREAD_PRIORITY_TIME_CRITICAL);
+    CloseHandle(thread_handle); // Lives for the whole daemon lifetime
+  }
+}
+
+// ============================================================
+// PIPE SERVER (IOCP state machine per instance)
+// ============================================================
+
+// Instances are recycled, never recreated, so a failure here means the
+// name is squatted or we're out of resources; retrying on a timer would
+// only hide that.
+[[nodiscard]]
+static HANDLE CreatePipeInstance(void) {
+  return CreateNamedPipeA(
+      PIPE_NAME, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+      PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_MAX_INST,
+      PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, nullptr);
+}
+
+static void BeginConnect(PipeSession *session);
+
+static void ResetSession(PipeSession *session) {
+  DisconnectNamedPipe(session->pipe);
+  BeginConnect(session);
+}
+
+static void BeginRead(PipeSession *session) {
+  ClientSession *client = &session->client;
+  session->state = SESSION_READING;
+  session->overlapped = (OVERLAPPED){0};
+
+  // Even a synchronous success posts a packet, so the worker sees every read.
+  // New bytes land right after any incomplete frame kept from the last one.
+  if (ReadFile(session->pipe, client->buffer + client->buffered,
+               READ_BUFFER_SIZE - client->buffered, nullptr,
+               &session->overlapped) == FALSE &&
+      GetLastError() != ERROR_IO_PENDING) {
+    SessionClosed(client);
+    ResetSession(session); // Client went away between reads
+  }
+}
+
+// Arms an overlapped ConnectNamedPipe so exactly one packet reports the
+// next client, whichever way the call returns
+static void ListenOnInstance(HANDLE pipe, OVERLAPPED *overlapped,
+                             CompletionKey key) {
+  while (true) {
+    *overlapped = (OVERLAPPED){0};
+
+    if (ConnectNamedPipe(pipe, overlapped) != FALSE)
+      return; // Completion packet is on its way
+
+    switch (GetLastError()) {
+    case ERROR_IO_PENDING:
+      return;
+    case ERROR_PIPE_CONNECTED:
+      // A client slipped in before we asked; no packet will be queued for it
+      PostQueuedCompletionStatus(completion_port, 0, key, overlapped);
+      return;
+    default:
+      // ERROR_NO_DATA: it already hung up. Recycle and listen again.
+      DisconnectNamedPipe(pipe);
+      break;
+    }
+  }
+}
+
+static void BeginConnect(PipeSession *session) {
+  session->state = SESSION_CONNECTING;
+  ListenOnInstance(session->pipe, &session->overlapped, COMPLETION_SESSION);
+}
+
+static void OnSessionCompletion(PipeSession *session, BOOL ok,
+                                DWORD bytes_transferred) {
+  switch (session->state) {
+  case SESSION_CONNECTING:
+    if (ok != FALSE) {
+      SessionOpen(&session->client);
+      BeginRead(session);
+    } else {
+      ResetSession(session);
+    }
+    break;
+  case SESSION_READING:
+    // ERROR_BROKEN_PIPE: the editor closed its end
+    if (ok == FALSE || bytes_transferred == 0) {
+      SessionClosed(&session->client);
+      ResetSession(session);
+    } else if (!SessionReceive(&session->client, bytes_transferred,
+                               PlatformNowTicks())) {
+      ResetSession(session);
+    } else {
+      BeginRead(session);
+    }
+    break;
+  }
+}
+
+static void OnServiceCompletion(ServicePipe *service, BOOL ok,
+                                DWORD bytes_transferred);
+
+// The daemon's only wait: sessions, service pipes, sounds/ changes and
+// posted commands all arrive here. Idle, every worker sleeps in the kernel.
+// A worker joins MMCSS on its first session read, so a daemon nobody has
+// typed into yet never loads avrt.dll.
+static DWORD WINAPI PipeWorkerThread([[maybe_unused]] LPVOID parameter) {
+  bool tuned = !daemon_mode;
+  while (true) {
+    DWORD bytes_transferred = 0;
+    ULONG_PTR key = 0;
+    OVERLAPPED *overlapped = nullptr;
+    const BOOL ok = GetQueuedCompletionStatus(
+        completion_port, &bytes_transferred, &key, &overlapped, INFINITE);
+
+    if (ok == FALSE && overlapped == nullptr)
+      return 1; // The port itself failed; nothing left to serve
+
+    switch ((CompletionKey)key) {
+    case COMPLETION_SESSION:
+      if (!tuned) {
+        TuneLatencyThread(AVRT_PRIORITY_NORMAL); // Decode + dispatch runs here
+        tuned = true;
+      }
+      OnSessionCompletion(
+          CONTAINING_RECORD(overlapped, PipeSession, overlapped), ok,
+          bytes_transferred);
+      break;
+    case COMPLETION_SERVICE:
+      OnServiceCompletion(
+          CONTAINING_RECORD(overlapped, ServicePipe, overlapped), ok,
+          bytes_transferred);
+      break;
+    case COMPLETION_SOUNDS:
+      OnSoundWatchCompletion(ok);
+      break;
+    case COMPLETION_RELOAD:
+      ReloadSoundsLocked(true);
+      break;
+    case COMPLETION_SHUTDOWN:
+      DaemonLog("Shutting down\n");
+      ExitProcess(EXIT_SUCCESS);
+    }
+  }
+}
+
+[[nodiscard]]
+static bool StartPipeServer(DWORD worker_count) {
+  completion_port =
+      CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, worker_count);
+  if (completion_port == nullptr)
+    return false;
+
+  pipe_pool = ArenaAlloc(sizeof(PipeSession) * (size_t)pool_config.clients);
+  if (pipe_pool == nullptr)
+    return false;
+  for (int i = 0; i < pool_config.clients; i++) {
+    PipeSession *session = &pipe_pool[i];
+    session->pipe = CreatePipeInstance();
+    if (session->pipe == INVALID_HANDLE_VALUE ||
+        CreateIoCompletionPort(session->pipe, completion_port,
+                               COMPLETION_SESSION, 0) == nullptr)
+      return false;
+    BeginConnect(session);
+  }
+
+  // The calling thread becomes the last worker
+  for (DWORD i = 1; i < worker_count; i++) {
+    HANDLE thread_handle =
+        CreateThread(nullptr, 0, PipeWorkerThread, nullptr, 0, nullptr);
+    if (thread_handle != nullptr) {
+      CloseHandle(thread_handle); // Lives for the whole daemon lifetime
+    }
+  }
+  return true;
+}
+
+[[nodiscard]]
+static DWORD CountPipeWorkers(void) {
+  const DWORD cores = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+  if (cores == 0)
+    return 1;
+  return cores > (DWORD)MAX_PIPE_WORKERS ? (DWORD)MAX_PIPE_WORKERS : cores;
+}
+
+// ============================================================
+// SERVICE PIPES (Control commands + stats snapshots, on the same port)
+// ============================================================
+static void BeginServiceConnect(ServicePipe *service) {
+  service->state = SERVICE_CONNECTING;
+  service->exit_when_drained = false;
+  ListenOnInstance(service->pipe, &service->overlapped, COMPLETION_SERVICE);
+}
+
+// The exchange is over: recycle the instance, or leave after a handoff.
+// The session mutex is then released as abandoned, which a waiting
+// successor treats as a normal acquire.
+static void FinishService(ServicePipe *service) {
+  if (service->exit_when_drained) {
+    DaemonLog("Handing off; exiting\n");
+    ExitProcess(EXIT_SUCCESS);
+  }
+  DisconnectNamedPipe(service->pipe);
+  BeginServiceConnect(service);
+}
+
+// Reads land in `buffer`; writes send its first `length` bytes
+static void BeginServiceIo(ServicePipe *service, ServiceState state,
+                           DWORD length) {
+  service->state = state;
+  service->overlapped = (OVERLAPPED){0};
+
+  const BOOL started =
+      state == SERVICE_WRITING
+          ? WriteFile(service->pipe, service->buffer, length, nullptr,
+                      &service->overlapped)
+          : ReadFile(service->pipe, service->buffer, SERVICE_BUFFER_SIZE - 1,
+                     nullptr, &service->overlapped);
+  if (started == FALSE && GetLastError() != ERROR_IO_PENDING) {
+    FinishService(service); // Client is gone already
+  }
+}
+
+static void AnswerControlCommand(ServicePipe *service, DWORD length) {
+  char command[CONTROL_COMMAND_MAX];
+  if (length >= sizeof(command)) {
+    length = sizeof(command) - 1;
+  }
+  memcpy(command, service->buffer, length);
+  while (length > 0 &&
+         (command[length - 1] == '\n' || command[length - 1] == '\r' ||
+          command[length - 1] == ' ')) {
+    length--;
+  }
+  command[length] = '\0';
+
+  service->exit_when_drained =
+      HandleControlCommand(command, service->buffer, SERVICE_BUFFER_SIZE) ==
+      CONTROL_EXIT;
+  BeginServiceIo(service, SERVICE_WRITING, (DWORD)strlen(service->buffer));
+}
+
+static void OnServiceCompletion(ServicePipe *service, BOOL ok,
+                                DWORD bytes_transferred) {
+  switch (service->state) {
+  case SERVICE_CONNECTING:
+    if (ok == FALSE) {
+      FinishService(service);
+    } else if (service->kind == SERVICE_STATS) {
+      const int length = FormatStatsJson(service->buffer, SERVICE_BUFFER_SIZE);
+      BeginServiceIo(service, SERVICE_WRITING, (DWORD)length);
+    } else {
+      BeginServiceIo(service, SERVICE_READING, 0);
+    }
+    break;
+  case SERVICE_READING:
+    if (ok == FALSE) {
+      FinishService(service); // Includes ERROR_MORE_DATA: not a command
+    } else {
+      AnswerControlCommand(service, bytes_transferred);
+    }
+    break;
+  case SERVICE_WRITING:
+    if (ok == FALSE) {
+      FinishService(service);
+    } else {
+      BeginServiceIo(service, SERVICE_DRAINING, 0);
+    }
+    break;
+  case SERVICE_DRAINING:
+    FinishService(service); // Broken pipe: the reply was read
+    break;
+  }
+}
+
+[[nodiscard]]
+static bool StartServicePipe(ServiceKind kind, const char *name) {
+  ServicePipe *service = &service_pipes[kind];
+  service->kind = kind;
+  service->pipe = CreateNamedPipeA(
+      name,
+      PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE |
+          FILE_FLAG_OVERLAPPED,
+      PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT |
+          PIPE_REJECT_REMOTE_CLIENTS,
+      1, SERVICE_BUFFER_SIZE, SERVICE_BUFFER_SIZE, 0, nullptr);
+  if (service->pipe == INVALID_HANDLE_VALUE ||
+      CreateIoCompletionPort(service->pipe, completion_port,
+                             COMPLETION_SERVICE, 0) == nullptr)
+    return false;
+
+  BeginServiceConnect(service);
+  return true;
+}
+
+// ============================================================
+// SHARED-MEMORY RINGS (Consumer thread + claims from the control pipe)
+// ============================================================
+// Copies out everything published so far and feeds it to the core.
+// Caller holds ring_lock (shared). Returns true if any ring had events.
+[[nodiscard]]
+static bool DrainRings(void) {
+  bool drained = false;
+  for (int i = 0; i < RING_COUNT; i++) {
+    if (ring_clients[i].owner == nullptr)
+      continue;
+    EventRing *ring = &ring_area->rings[i];
+    const uint32_t tail = atomic_load_explicit(&ring->tail,
+                                               memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&ring->head,
+                                               memory_order_acquire);
+    const uint32_t available = head - tail;
+    if (available == 0)
+      continue;
+    drained = true;
+    if (available > RING_CAPACITY) {
+      // The client wrote past the ring; what is in it can't be trusted
+      atomic_store_explicit(&ring->tail, head, memory_order_release);
+      continue;
+    }
+
+    ClackEvent events[RING_CAPACITY];
+    const uint32_t start = tail & (RING_CAPACITY - 1);
+    const uint32_t first = available < RING_CAPACITY - start
+                               ? available
+                               : RING_CAPACITY - start;
+    memcpy(events, &ring->events[start], first * sizeof(ClackEvent));
+    memcpy(events + first, ring->events,
+           (available - first) * sizeof(ClackEvent));
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+    SessionDeliver(&ring_clients[i].client, events, available,
+                   PlatformNowTicks());
+  }
+  return drained;
+}
+
+// A producer's head store may still sit in its core's store buffer when
+// it reads `consumer_idle`, and then it skips the wake. Watching the heads
+// for a moment after raising the flag catches most of those; the bounded
+// wait in RingConsumerThread catches the rest.
+// Caller holds ring_lock (shared).
+[[nodiscard]]
+static bool RingsPendingAfterIdle(void) {
+  for (int spin = 0; spin < RING_IDLE_SPINS; spin++) {
+    for (int i = 0; i < RING_COUNT; i++) {
+      const EventRing *ring = &ring_area->rings[i];
+      if (ring_clients[i].owner != nullptr &&
+          atomic_load(&ring->head) != atomic_load(&ring->tail))
+        return true;
+    }
+    YieldProcessor();
+  }
+  return false;
+}
+
+// The owning editor exited; its ring is free for the next claim
+static void ReleaseRing(int index) {
+  AcquireSRWLockExclusive(&ring_lock);
+  CloseHandle(ring_clients[index].owner);
+  ring_clients[index].owner = nullptr;
+  ring_area->rings[index].owner_pid = 0;
+  SessionClosed(&ring_clients[index].client); // Before a claim can reopen it
+  ReleaseSRWLockExclusive(&ring_lock);
+}
+
+// Sleeps on the wake event and on every owner process, so a claim, an
+// event published while idle and an editor exiting all end the wait. With
+// a ring claimed the sleep also times out, starting short since a missed
+// wake can only come from a publish near the moment the flag went up.
+static DWORD WINAPI RingConsumerThread([[maybe_unused]] LPVOID parameter) {
+  TuneLatencyThread(AVRT_PRIORITY_NORMAL);
+  DWORD idle_wait_ms = RING_IDLE_WAIT_FIRST_MS;
+  while (true) {
+    HANDLE waits[1 + RING_COUNT] = {ring_wake_event};
+    int wait_rings[1 + RING_COUNT] = {-1};
+    DWORD wait_count = 1;
+
+    AcquireSRWLockShared(&ring_lock);
+    bool pending = DrainRings();
+    if (pending) {
+      idle_wait_ms = RING_IDLE_WAIT_FIRST_MS;
+    } else {
+      atomic_store(&ring_area->consumer_idle, 1);
+      pending = RingsPendingAfterIdle();
+    }
+    for (int i = 0; i < RING_COUNT && !pending; i++) {
+      if (ring_clients[i].owner != nullptr) {
+        waits[wait_count] = ring_clients[i].owner;
+        wait_rings[wait_count] = i;
+        wait_count++;
+      }
+    }
+    ReleaseSRWLockShared(&ring_lock);
+
+    if (!pending) {
+      const DWORD timeout = wait_count > 1 ? idle_wait_ms : INFINITE;
+      const DWORD result =
+          WaitForMultipleObjects(wait_count, waits, FALSE, timeout);
+      if (result == WAIT_FAILED) {
+        DaemonLog("Ring transport stopped (Error %lu)\n", GetLastError());
+        return 0;
+      }
+      if (result == WAIT_TIMEOUT && idle_wait_ms < RING_IDLE_WAIT_LAST_MS) {
+        idle_wait_ms *= 2; // Nothing was missed; back off
+      }
+      if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + wait_count) {
+        ReleaseRing(wait_rings[result - WAIT_OBJECT_0]);
+      }
+    }
+    atomic_store(&ring_area->consumer_idle, 0);
+  }
+}
+
+// Claimed rings survive a --takeover: editors keep their mapping open, so
+// the successor opens the same section and re-attaches to every owner.
+static void AdoptRingOwners(void) {
+  for (int i = 0; i < RING_COUNT; i++) {
+    EventRing *ring = &ring_area->rings[i];
+    if (ring->owner_pid == 0)
+      continue;
+    ring_clients[i].owner = OpenProcess(SYNCHRONIZE, FALSE, ring->owner_pid);
+    if (ring_clients[i].owner == nullptr) {
+      ring->owner_pid = 0; // Exited while nobody was consuming
+      continue;
+    }
+    // Whatever piled up between daemons is stale by now
+    atomic_store(&ring->tail, atomic_load(&ring->head));
+    SessionOpen(&ring_clients[i].client);
+    ring_clients[i].client.target.pid = ring->owner_pid; // Window unknown
+  }
+}
+
+static BOOL CALLBACK OpenRingArea([[maybe_unused]] PINIT_ONCE once,
+                                  [[maybe_unused]] PVOID parameter,
+                                  [[maybe_unused]] PVOID *context) {
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+                                      PAGE_READWRITE, 0, sizeof(RingArea),
+                                      RING_MAPPING_NAME);
+  if (mapping == nullptr)
+    return FALSE;
+  const bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+  RingArea *area =
+      MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(RingArea));
+  CloseHandle(mapping); // The view keeps the section alive
+  if (area == nullptr)
+    return FALSE;
+
+  if (!existed) {
+    area->magic = RING_MAGIC;
+    area->version = RING_VERSION;
+    area->ring_count = RING_COUNT;
+    area->capacity = RING_CAPACITY;
+  } else if (area->magic != RING_MAGIC || area->version != RING_VERSION) {
+    DaemonLog("Ring transport disabled: %s has an older layout\n",
+              RING_MAPPING_NAME);
+    UnmapViewOfFile(area);
+    return FALSE;
+  }
+
+  ring_wake_event = CreateEventA(nullptr, FALSE, FALSE, RING_WAKE_NAME);
+  if (ring_wake_event == nullptr) {
+    UnmapViewOfFile(area);
+    return FALSE;
+  }
+  ring_area = area;
+  if (existed) {
+    AdoptRingOwners();
+  }
+
+  HANDLE thread_handle =
+      CreateThread(nullptr, 0, RingConsumerThread, nullptr, 0, nullptr);
+  if (thread_handle == nullptr)
+    return FALSE;
+  CloseHandle(thread_handle); // Lives for the whole daemon lifetime
+  DaemonLog("Ring transport on %s (%d rings)\n", RING_MAPPING_NAME,
+            RING_COUNT);
+  return TRUE;
+}
+
+[[nodiscard]]
+static bool EnsureRingArea(void) {
+  return InitOnceExecuteOnce(&ring_area_once, OpenRingArea, nullptr,
+                             nullptr) != FALSE;
+}
+
+// Nothing is mapped until the first claim, unless a daemon we replaced
+// left rings that editors still hold open.
+static void AdoptRingArea(void) {
+  HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, RING_MAPPING_NAME);
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+    (void)EnsureRingArea();
+  }
+}
+
+int PlatformClaimRing(const EffectTarget *target) {
+  if (!EnsureRingArea())
+    return -1;
+  const uint32_t pid = target->pid;
+  HANDLE owner = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+  if (owner == nullptr)
+    return -1;
+
+  int index = -1;
+  AcquireSRWLockExclusive(&ring_lock);
+  // An editor re-sourcing its config gets its own ring back
+  for (int i = 0; i < RING_COUNT && index < 0; i++) {
+    if (ring_clients[i].owner != nullptr &&
+        ring_area->rings[i].owner_pid == pid) {
+      index = i;
+    }
+  }
+  for (int i = 0; i < RING_COUNT && index < 0; i++) {
+    if (ring_clients[i].owner == nullptr) {
+      EventRing *ring = &ring_area->rings[i];
+      ring->owner_pid = pid;
+      atomic_store(&ring->tail, atomic_load(&ring->head));
+      ring_clients[i].owner = owner;
+      owner = nullptr;
+      SessionOpen(&ring_clients[i].client);
+      ring_clients[i].client.target = *target;
+      index = i;
+    }
+  }
+  ReleaseSRWLockExclusive(&ring_lock);
+
+  if (owner != nullptr) {
+    CloseHandle(owner); // Re-claim, or every ring is taken
+  }
+  SetEvent(ring_wake_event); // The consumer picks up the new owner
+  return index;
+}
+
+// Console close and Ctrl+C come in on a system thread; the port turns
+// them into an ordinary completion.
+static BOOL WINAPI OnConsoleControl([[maybe_unused]] DWORD control_type) {
+  PostQueuedCompletionStatus(completion_port, 0, COMPLETION_SHUTDOWN, nullptr);
+  return TRUE;
+}
+
+// Asks the running daemon to step aside, then waits to own the session
+// mutex. Our pipe instances are already up, so the name never disappears.
+[[nodiscard]]
+static bool TakeOverInstance(HANDLE instance_mutex) {
+  char command[] = "handoff";
+  char reply[CONTROL_COMMAND_MAX];
+  DWORD reply_length = 0;
+  if (CallNamedPipeA(CONTROL_PIPE_NAME, command, sizeof(command) - 1, reply,
+                     sizeof(reply), &reply_length,
+                     HANDOFF_TIMEOUT_MS) == FALSE) {
+    DaemonLog("Running daemon did not accept handoff (Error %lu)\n",
+              GetLastError());
+    return false;
+  }
+
+  const DWORD acquired =
+      WaitForSingleObject(instance_mutex, HANDOFF_TIMEOUT_MS);
+  return acquired == WAIT_OBJECT_0 || acquired == WAIT_ABANDONED;
+}
+
+// ============================================================
+// INTENSITY BUS (Read-only mappings for effect renderers)
+// ============================================================
+// Readers open this by name with FILE_MAP_READ. A daemon taking over maps
+// the section its predecessor still holds and keeps writing the same bus.
+static const char *const BUS_MAPPING_NAME = "Local\\nvim_clack_bus";
+
+void *PlatformMapBus(size_t bytes) {
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+                                      PAGE_READWRITE, 0, (DWORD)bytes,
+                                      BUS_MAPPING_NAME);
+  if (mapping == nullptr)
+    return nullptr;
+  void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+  CloseHandle(mapping); // The view keeps the section alive
+  if (view != nullptr) {
+    DaemonLog("Intensity bus on %s\n", BUS_MAPPING_NAME);
+  }
+  return view;
+}
+
+// ============================================================
+// DAEMON LIFECYCLE
+// ============================================================
+int PlatformRunDaemon(void) {
+  // Every editor launch runs us; all but the first should cost nothing
+  HANDLE instance_mutex = CreateMutexA(nullptr, TRUE, INSTANCE_MUTEX_NAME);
+  if (instance_mutex == nullptr)
+    return EXIT_FAILURE;
+  const bool already_running = GetLastError() == ERROR_ALREADY_EXISTS;
+  if (already_running && !takeover_requested) {
+    DaemonLog("Daemon already running; exiting\n");
+    return EXIT_SUCCESS;
+  }
+  daemon_mode = true;
+  ApplyProcessQos();
+  InstallHeapTrap();
+
+  const DWORD worker_count = CountPipeWorkers();
+  if (!StartPipeServer(worker_count)) {
+    DaemonLog("Could not start pipe server (Error %lu)\n", GetLastError());
+    return EXIT_FAILURE;
+  }
+  ArenaSeal();
+  if (already_running && !TakeOverInstance(instance_mutex))
+    return EXIT_FAILURE;
+  if (!StartServicePipe(SERVICE_CONTROL, CONTROL_PIPE_NAME) ||
+      !StartServicePipe(SERVICE_STATS, STATS_PIPE_NAME)) {
+    DaemonLog("Could not open control/stats pipes (Error %lu)\n",
+              GetLastError());
+  }
+  AdoptRingArea();
+  SetConsoleCtrlHandler(OnConsoleControl, TRUE);
+  DaemonLog("Listening on %s (%d instances, %lu workers)\n", PIPE_NAME,
+            pool_config.clients, worker_count);
+  DaemonLog("Stats on %s\n", STATS_PIPE_NAME);
+  StartIntensityBus();
+  DaemonLog("Scheduling: MMCSS %s, EcoQoS %s, affinity 0x%llx\n",
+            scheduling_config.mmcss ? "on" : "off",
+            scheduling_config.allow_ecoqos ? "allowed" : "opted out",
+            (unsigned long long)scheduling_config.affinity);
+
+  // Only returns if the completion port breaks
+  (void)PipeWorkerThread(nullptr);
+  return EXIT_FAILURE;
+}
+
+// The library's only worker, on a port of its own. It only ever sees the
+// sounds/ watch and reload requests.
+bool PlatformStartEmbedded(void) {
+  completion_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+  if (completion_port == nullptr)
+    return false;
+  HANDLE thread_handle =
+      CreateThread(nullptr, 0, PipeWorkerThread, nullptr, 0, nullptr);
+  if (thread_handle == nullptr)
+    return false;
+  CloseHandle(thread_handle); // Lives as long as the host process
+  return true;
+}